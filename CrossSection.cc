@@ -0,0 +1,239 @@
+#include "CrossSection.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+using namespace std;
+
+namespace {
+   const double kMe = 0.51099895; // electron mass in MeV
+   const double kDelta = 1.29333; // neutron-proton mass difference in MeV
+   const double kAmu = 931.494; // atomic mass unit in MeV
+   const double kGF = 1.1663787e-11; // Fermi constant in MeV^-2
+   const double kHbarC = 197.3269804; // MeV*fm
+   const double kHbarC2 = 3.893793721e-22; // (hbar*c)^2 in MeV2*cm2
+   const double kSin2W = 0.2312; // weak mixing angle
+
+   // 8-point Gauss-Legendre quadrature on [-1, 1]
+   const double kNode[8] = {-0.9602898564975363, -0.7966664774136267,
+      -0.5255324099163290, -0.1834346424956498, 0.1834346424956498,
+      0.5255324099163290, 0.7966664774136267, 0.9602898564975363};
+   const double kWeight[8] = {0.1012285362903763, 0.2223810344533745,
+      0.3137066458778873, 0.3626837833783620, 0.3626837833783620,
+      0.3137066458778873, 0.2223810344533745, 0.1012285362903763};
+
+   // integral of f over [a, b]
+   template<class Function> double Gauss(Function f, double a, double b)
+   {
+      double c = (a+b)/2, h = (b-a)/2, sum = 0;
+      for (int i=0; i<8; i++) sum += kWeight[i]*f(c+h*kNode[i]);
+      return sum*h;
+   }
+
+   bool IsAnti(unsigned short type) { return type%2==0; }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::CrossSection::CrossSection(EChannel channel) : fChannel(channel),
+   fA(40), fZ(18), fShift(0), fLogE(), fError()
+{
+   if (fChannel==kTable) fError = "no table is loaded";
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::CrossSection::LoadTable(const char *file, double shift)
+{
+   fLogE.clear();
+   for (int k=0; k<6; k++) fTable[k].clear();
+
+   ifstream in(file);
+   if (!in) {
+      fError = string(file) + ": cannot be opened";
+      return false;
+   }
+   string line;
+   for (unsigned int n=1; getline(in, line); n++) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first==string::npos || line[first]=='#') continue;
+
+      double values[7];
+      const char *cursor = line.c_str();
+      for (int k=0; k<7; k++) {
+         char *end;
+         values[k] = strtod(cursor, &end);
+         if (end==cursor) {
+            fError = string(file) + ":" + to_string(n)
+               + ": 7 numbers are expected";
+            fLogE.clear();
+            return false;
+         }
+         cursor = end;
+      }
+      if (!fLogE.empty() && values[0]<=fLogE.back()) {
+         fError = string(file) + ":" + to_string(n)
+            + ": energies must increase";
+         fLogE.clear();
+         return false;
+      }
+      fLogE.push_back(values[0]);
+      for (int k=0; k<6; k++) fTable[k].push_back(values[k+1]);
+   }
+   if (fLogE.size()<2) {
+      fError = string(file) + ": less than 2 rows";
+      fLogE.clear();
+      return false;
+   }
+   fChannel = kTable;
+   fShift = shift;
+   fError.clear();
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::CrossSection::Threshold(unsigned short type) const
+{
+   switch (fChannel) {
+      case kIBD: return type==2 ? kDelta+kMe : HUGE_VAL;
+      case kOxygenCC: return type==1 ? 15.4 : type==2 ? 11.4 : HUGE_VAL;
+      case kTable:
+         return fLogE.empty() ? HUGE_VAL : pow(10., fLogE.front())*1e3;
+      default: return 0;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::CrossSection::Sigma(unsigned short type, double energy) const
+{
+   if (type<1 || type>6 || !(energy>Threshold(type))) return 0;
+   switch (fChannel) {
+      case kIBD: {
+         double e = energy-kDelta, p = sqrt(e*e-kMe*kMe);
+         double l = log(energy);
+         return 1e-43*p*e*pow(energy, -0.07056+0.02018*l-0.001953*l*l*l);
+      }
+      case kElastic: return ElasticIntegral(type, energy, 0, energy);
+      case kCEvNS: return CoherentIntegral(energy, 0, energy);
+      case kOxygenCC:
+         if (type==1) return 4.7e-40*pow(pow(energy,0.25)-pow(15.,0.25), 6);
+         return 2.1e-41*pow(pow(energy,0.25)-pow(8.2,0.25), 6);
+      case kTable: {
+         double x = log10(energy*1e-3);
+         if (x>fLogE.back()) return 0;
+         size_t i = upper_bound(fLogE.begin(), fLogE.end(), x)-fLogE.begin();
+         // x is below fLogE[0] by rounding just above Threshold()
+         if (i==0) i = 1;
+         if (i>=fLogE.size()) i = fLogE.size()-1;
+         const vector<double> &y = fTable[(type-1)/2 + (IsAnti(type)?3:0)];
+         double w = (x-fLogE[i-1])/(fLogE[i]-fLogE[i-1]);
+         return (y[i-1]+(y[i]-y[i-1])*w)*1e-38*energy*1e-3;
+      }
+   }
+   return 0;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::CrossSection::ElasticIntegral(unsigned short type,
+      double energy, double t0, double t1) const
+{
+   double tmax = 2*energy*energy/(kMe+2*energy);
+   t0 = max(t0, 0.);
+   t1 = min(t1, tmax);
+   if (t1<=t0) return 0;
+
+   double gL = (type<3 ? 0.5 : -0.5) + kSin2W, gR = kSin2W;
+   if (IsAnti(type)) swap(gL, gR);
+   // antiderivative of [gL^2 + gR^2 (1-T/E)^2 - gL gR me T/E^2] over T
+   double e = energy;
+   auto F = [gL, gR, e](double t) {
+      double y = 1-t/e;
+      return gL*gL*t - gR*gR*e*y*y*y/3 - gL*gR*kMe*t*t/(2*e*e);
+   };
+   return 2*kGF*kGF*kMe/M_PI*kHbarC2*(F(t1)-F(t0));
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::CrossSection::CoherentIntegral(double energy,
+      double t0, double t1) const
+{
+   double m = fA*kAmu;
+   double tmax = 2*energy*energy/(m+2*energy);
+   t0 = max(t0, 0.);
+   t1 = min(t1, tmax);
+   if (t1<=t0) return 0;
+
+   // weak charge and Helm form factor, radii in fm
+   double qw = (fA-fZ) - (1-4*kSin2W)*fZ;
+   double c = 1.23*cbrt(fA)-0.6, a = 0.52, s = 0.9;
+   double r = sqrt(c*c + 7./3*M_PI*M_PI*a*a - 5*s*s);
+   double e = energy;
+   auto dsigma = [m, qw, r, s, e](double t) {
+      double q = sqrt(2*m*t+t*t)/kHbarC, x = q*r;
+      double f = x<1e-3 ? 1-x*x/10 : 3*(sin(x)/x-cos(x))/(x*x);
+      f *= exp(-q*q*s*s/2);
+      return kGF*kGF*m/(4*M_PI)*qw*qw*(1-m*t/(2*e*e))*f*f*kHbarC2;
+   };
+   return Gauss(dsigma, t0, t1);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::CrossSection::AddVisible(unsigned short type, double energy,
+      double weight, unsigned short nbins, const double *edges,
+      double *result) const
+{
+   if (type<1 || type>6 || !(energy>Threshold(type))) return;
+   if (fChannel==kElastic || fChannel==kCEvNS) {
+      for (unsigned short j=0; j<nbins; j++) {
+         double s = fChannel==kElastic ?
+            ElasticIntegral(type, energy, edges[j], edges[j+1]) :
+            CoherentIntegral(energy, edges[j], edges[j+1]);
+         result[j] += weight*s;
+      }
+      return;
+   }
+
+   // the rest goes to one visible energy
+   double shift = fShift;
+   if (fChannel==kIBD) shift = kDelta-kMe;
+   else if (fChannel==kOxygenCC) shift = type==1 ? 15.4 : 11.4;
+   double visible = energy-shift;
+   if (!(visible>=edges[0] && visible<edges[nbins])) return;
+   unsigned short j = upper_bound(edges, edges+nbins+1, visible)-edges-1;
+   result[j] += weight*Sigma(type, energy);
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::CrossSection::Integrate(unsigned short type, double e0,
+      double e1, unsigned short nbins, const double *edges,
+      double *visible) const
+{
+   e0 = max(e0, Threshold(type));
+   if (!(e1>e0)) return 0;
+   double c = (e0+e1)/2, h = (e1-e0)/2, sum = 0;
+   for (int i=0; i<8; i++) {
+      double energy = c+h*kNode[i];
+      sum += kWeight[i]*h*Sigma(type, energy);
+      if (visible)
+         AddVisible(type, energy, kWeight[i]*h, nbins, edges, visible);
+   }
+   return sum;
+}
+
+//______________________________________________________________________________
+//
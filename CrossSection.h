@@ -0,0 +1,100 @@
+#ifndef CROSSSECTION_H
+#define CROSSSECTION_H
+
+#include <string>
+#include <vector>
+
+namespace NEUS { class CrossSection; }
+
+/**
+ * Cross section of a detection channel per target, in cm2.
+ * Neutrino types are those of SupernovaModel: 1: v_e, 2: anti-v_e,
+ * 3: v_mu, 4: anti-v_mu, 5: v_tau, 6: anti-v_tau. Energies are in MeV.
+ *
+ * Analytic channels:
+ * kIBD: anti-v_e + p -> e+ + n, approximation of Strumia and Vissani,
+ *       Phys. Lett. B 564 (2003) 42. Visible energy: E_e+m_e = E-0.782.
+ * kElastic: v + e -> v + e at tree level for all types. Visible energy:
+ *       kinetic energy of the electron.
+ * kCEvNS: coherent elastic scattering on a nucleus, see SetNucleus(), with
+ *       the Helm form factor, for all types. Visible energy: kinetic
+ *       energy of the nucleus, without quenching.
+ * kOxygenCC: v_e + 16O -> e- + 16F and anti-v_e + 16O -> e+ + 16N, fits
+ *       of Tomas et al., Phys. Rev. D 68 (2003) 093013. Visible energy:
+ *       E-15.4 and E-11.4 for transitions to the ground states.
+ * kTable: cross sections loaded by LoadTable(), e.g. v_e + 40Ar -> e- +
+ *       40K*, for which there is no closed form.
+ *
+ * This class does not depend on ROOT.
+ */
+class NEUS::CrossSection
+{
+   public:
+      enum EChannel { kIBD=0, kElastic, kCEvNS, kOxygenCC, kTable };
+
+   private:
+      EChannel fChannel;
+      unsigned short fA, fZ; // nucleus of kCEvNS
+      double fShift; // E-E_vis of kTable
+      std::vector<double> fLogE; // log10(E/GeV) of kTable
+      std::vector<double> fTable[6]; // sigma/E of kTable, 1e-38 cm2/GeV
+      std::string fError;
+
+      /**
+       * Integrals of dsigma/dT over [t0, t1], for kElastic and kCEvNS.
+       */
+      double ElasticIntegral(unsigned short type, double energy,
+            double t0, double t1) const;
+      double CoherentIntegral(double energy, double t0, double t1) const;
+      /**
+       * Add weight*dsigma/dE_vis integrated over visible bins to result.
+       */
+      void AddVisible(unsigned short type, double energy, double weight,
+            unsigned short nbins, const double *edges, double *result) const;
+
+   public:
+      explicit CrossSection(EChannel channel=kIBD);
+
+      EChannel Channel() const { return fChannel; }
+      /**
+       * Nucleus of kCEvNS with mass number A and atomic number Z.
+       * It is 40Ar by default.
+       */
+      void SetNucleus(unsigned short A, unsigned short Z) { fA=A; fZ=Z; }
+      unsigned short A() const { return fA; }
+      unsigned short Z() const { return fZ; }
+
+      /**
+       * Load cross sections in the format of SNOwGLoBES and set the channel
+       * to kTable. Each row contains log10(E/GeV) followed by sigma/E in
+       * unit of 1e-38 cm2/GeV of v_e, v_mu, v_tau, anti-v_e, anti-v_mu and
+       * anti-v_tau. Lines starting with '#' are ignored. The visible
+       * energy is E-shift. Sigma/E is interpolated linearly in log10(E).
+       */
+      bool LoadTable(const char *file, double shift=0);
+      /**
+       * Why LoadTable() failed.
+       */
+      const char* Error() const { return fError.c_str(); }
+
+      /**
+       * Lowest energy at which Sigma(type, energy) is not 0.
+       */
+      double Threshold(unsigned short type) const;
+      /**
+       * Cross section per target in cm2.
+       */
+      double Sigma(unsigned short type, double energy) const;
+      /**
+       * Integral of Sigma(type, E) over [e0, e1] in cm2*MeV, with 8-point
+       * Gauss-Legendre quadrature above the threshold. If visible is given,
+       * the integral of dsigma/dE_vis is also added to visible[j] for each
+       * of nbins visible energy bins, whose nbins+1 edges are in edges.
+       * What falls out of them is dropped.
+       */
+      double Integrate(unsigned short type, double e0, double e1,
+            unsigned short nbins=0, const double *edges=0,
+            double *visible=0) const;
+};
+
+#endif
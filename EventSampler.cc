@@ -0,0 +1,110 @@
+#include "EventSampler.h"
+
+#include <algorithm>
+using namespace std;
+
+namespace {
+   // Cumulative row interpolated at a cut
+   double Cumulative(const double *row, unsigned short k, double frac)
+   {
+      return frac>0 ? row[k] + (row[k+1]-row[k])*frac : row[k];
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::EventSampler::EventSampler(const SpectrumGrid &grid,
+      unsigned short flavor) : fTaxis(), fEaxis(), fCumE(), fCumT(),
+   fGuide(), fTmin(0), fTmax(0), fEmin(0), fEmax(0), fK0(0), fK1(0),
+   fFrac0(0), fFrac1(0)
+{
+   if (grid.IsEmpty()) return;
+   const unsigned short nt = grid.TBins(), ne = grid.EBins();
+   fTaxis.Set(nt, grid.TimeAxis().Edges());
+   fEaxis.Set(ne, grid.EnergyAxis().Edges());
+
+   // negative contents, if any, cannot be drawn and are taken as 0
+   vector<double> buffer;
+   const double *c = grid.Content(SpectrumGrid::kNumber, flavor, buffer);
+   fCumE.assign(nt*(ne+1u), 0.);
+   for (unsigned short it=0; it<nt; it++) {
+      double *row = &fCumE[it*(ne+1u)];
+      for (unsigned short ie=0; ie<ne; ie++)
+         row[ie+1] = row[ie]
+            + max(c[it*ne+ie], 0.) * fEaxis.BinWidth(ie);
+   }
+   SetWindow(fTaxis.Min(), fTaxis.Max(), fEaxis.Min(), fEaxis.Max());
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::EventSampler::SetWindow(double tmin, double tmax,
+      double emin, double emax)
+{
+   if (fCumE.empty()) return;
+   const unsigned short nt = fTaxis.GetNbins(), ne = fEaxis.GetNbins();
+   fTmin = max(tmin, fTaxis.Min());
+   fTmax = max(min(tmax, fTaxis.Max()), fTmin);
+   fEmin = max(emin, fEaxis.Min());
+   fEmax = max(min(emax, fEaxis.Max()), fEmin);
+   fEaxis.Cut(fEmin, fK0, fFrac0);
+   fEaxis.Cut(fEmax, fK1, fFrac1);
+
+   const double *edges = fTaxis.Edges();
+   fCumT.assign(nt+1u, 0.);
+   for (unsigned short it=0; it<nt; it++) {
+      const double *row = &fCumE[it*(ne+1u)];
+      double lo = max(edges[it], fTmin), hi = min(edges[it+1], fTmax);
+      double n = Cumulative(row, fK1, fFrac1) - Cumulative(row, fK0, fFrac0);
+      fCumT[it+1] = fCumT[it] + (hi>lo && n>0 ? (hi-lo)*n : 0);
+   }
+
+   fGuide.assign(nt, 0);
+   for (unsigned short k=0, it=0; k<nt; k++) {
+      while (it<nt-1 && fCumT[it+1]<=fCumT[nt]*k/nt) it++;
+      fGuide[k] = it;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::EventSampler::Transform(const double *u, double *time,
+      double *energy, size_t n) const
+{
+   const double total = Total();
+   if (!(total>0)) return;
+   const int nt = fTaxis.GetNbins(), ne = fEaxis.GetNbins();
+   const double *edgesT = fTaxis.Edges(), *edgesE = fEaxis.Edges();
+   const double *cumT = &fCumT[0];
+   const int last = fFrac1>0 ? fK1 : fK1-1; // last energy bin in the window
+
+   for (size_t i=0; i<n; i++, u+=3) {
+      // first time bin in which the cumulative number exceeds the draw
+      double x = u[0]*total;
+      int it = fGuide[min(int(u[0]*nt), nt-1)];
+      while (it>0 && cumT[it]>x) it--; // rounding at the guide boundary
+      while (it<nt-1 && cumT[it+1]<=x) it++;
+      // only a draw rounded up to 1 can end in an empty last bin
+      while (it>0 && cumT[it+1]==cumT[it]) it--;
+      double lo = max(edgesT[it], fTmin), hi = min(edgesT[it+1], fTmax);
+      time[i] = lo + u[1]*(hi-lo);
+
+      // N is constant in a bin, so its cumulative is linear in it
+      const double *row = &fCumE[it*(ne+1)];
+      double c0 = Cumulative(row, fK0, fFrac0);
+      x = c0 + u[2]*(Cumulative(row, fK1, fFrac1)-c0);
+      int ie = upper_bound(row+fK0+1, row+last+1, x) - row - 1;
+      while (ie>fK0 && row[ie+1]==row[ie]) ie--;
+      lo = max(edgesE[ie], fEmin);
+      hi = min(edgesE[ie+1], fEmax);
+      double e = edgesE[ie]
+         + (x-row[ie])/(row[ie+1]-row[ie])*(edgesE[ie+1]-edgesE[ie]);
+      energy[i] = min(max(e, lo), hi);
+   }
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,114 @@
+#ifndef EVENTSAMPLER_H
+#define EVENTSAMPLER_H
+
+#include "SpectrumGrid.h"
+
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace NEUS { class EventSampler; }
+
+/**
+ * Draw arrival times and energies of neutrinos of one flavor from N(t, E).
+ * N(t, E) is taken as constant in each bin of the grid, as Nall() and Ne()
+ * integrate it, so drawn events follow it exactly, also inside bins, and
+ * no draw is wasted. The inverse of cumulative distributions is used: a
+ * time bin is picked from the numbers of neutrinos in the time bins, then
+ * the energy from the cumulative energy spectrum of that time bin. The
+ * search of the time bin starts from a guide table, so it takes O(1)
+ * steps on average. Energy spectra are integrated once, so restricting
+ * events to a window of time and energy with SetWindow() only takes
+ * O(TBins()).
+ *
+ * Sample() is const and can be called from many threads at the same time,
+ * each with its own random number generator. SetWindow() must not be called
+ * meanwhile. This class does not depend on ROOT.
+ */
+class NEUS::EventSampler
+{
+   private:
+      static const std::size_t fgBatch = 256; // events per call of Transform()
+
+      GridAxis fTaxis, fEaxis;
+      /**
+       * Integrals of N over the first k energy bins, k from 0 to EBins(),
+       * in each time bin. There are TBins() rows of EBins()+1 values.
+       */
+      std::vector<double> fCumE;
+      /**
+       * Numbers of neutrinos in the window in the first k time bins, k from
+       * 0 to TBins().
+       */
+      std::vector<double> fCumT;
+      /**
+       * First time bin whose cumulative number exceeds k/TBins() of Total(),
+       * k from 0 to TBins()-1, where the search for a draw starts.
+       */
+      std::vector<unsigned short> fGuide;
+
+      double fTmin, fTmax, fEmin, fEmax; // window
+      unsigned short fK0, fK1; // energy bins containing fEmin and fEmax
+      double fFrac0, fFrac1; // fractions of them below fEmin and fEmax
+
+      EventSampler(const EventSampler&);
+      EventSampler& operator=(const EventSampler&);
+
+   public:
+      /**
+       * Build tables from N(t, E) of a flavor in grid.
+       * See SpectrumGrid::Flavor() for flavor indices.
+       * The window is set to the full grid.
+       */
+      EventSampler(const SpectrumGrid &grid, unsigned short flavor);
+
+      /**
+       * Only draw events in [tmin, tmax] x [emin, emax].
+       * The window is limited to the grid. Bins on its border are cut
+       * exactly.
+       */
+      void SetWindow(double tmin, double tmax, double emin, double emax);
+      double TMin() const { return fTmin; }
+      double TMax() const { return fTmax; }
+      double EMin() const { return fEmin; }
+      double EMax() const { return fEmax; }
+
+      /**
+       * Number of neutrinos in the window, in unit of 1e50.
+       * It is the mean number of events to draw for a supernova at 10 kpc
+       * before detector effects.
+       */
+      double Total() const { return fCumT.empty() ? 0 : fCumT.back(); }
+
+      /**
+       * Convert n triplets of uniform random numbers in [0, 1) in u to
+       * events saved in time[i] and energy[i]. u holds 3*n values. It is
+       * what Sample() does with numbers drawn from its generator. Total()
+       * must be positive.
+       */
+      void Transform(const double *u, double *time, double *energy,
+            std::size_t n) const;
+
+      /**
+       * Draw n events in the window and save them in time[i] and energy[i].
+       * rng is any C++11 uniform random bit generator, e.g. one
+       * std::mt19937_64 per thread seeded differently. Nothing is drawn
+       * and false is returned if Total() is 0.
+       */
+      template<class URNG>
+      bool Sample(URNG &rng, double *time, double *energy, std::size_t n) const
+      {
+         if (!(Total()>0)) return false;
+         double u[3*fgBatch];
+         for (std::size_t k=0; k<n; k+=fgBatch) {
+            std::size_t m = n-k<fgBatch ? n-k : fgBatch;
+            for (std::size_t i=0; i<3*m; i++)
+               u[i] = std::generate_canonical<double,
+                  std::numeric_limits<double>::digits>(rng);
+            Transform(u, time+k, energy+k, m);
+         }
+         return true;
+      }
+};
+
+#endif
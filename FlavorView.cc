@@ -0,0 +1,148 @@
+#include "FlavorView.h"
+#include "SpectrumGrid.h"
+
+#include <algorithm>
+using namespace std;
+
+const Double_t NEUS::FlavorView::fgSin2Theta12 = 0.307;
+const Double_t NEUS::FlavorView::fgSin2Theta13 = 0.0220;
+
+//______________________________________________________________________________
+//
+
+NEUS::FlavorView::FlavorView(const SupernovaModel &model, EScenario scenario)
+   : fModel(&model)
+{
+   for (UShort_t i=0; i<3; i++) fWeights[0][i] = 0;
+   SetScenario(scenario);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::FlavorView::SetScenario(EScenario scenario)
+{
+   const Double_t s12 = fgSin2Theta12, s13 = fgSin2Theta13;
+   if (scenario==kNormal) SetSurvival(s13, (1-s12)*(1-s13));
+   else if (scenario==kInverted) SetSurvival(s12*(1-s13), s13);
+   else if (scenario==kSwap) SetSurvival(0, 0);
+   else SetSurvival(1, 1);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::FlavorView::SetSurvival(Double_t p, Double_t pbar)
+{
+   // v_e, anti-v_e, then each of v_mu, anti-v_mu, v_tau, anti-v_tau
+   const Double_t ve[3] = {p, 0, 1-p};
+   const Double_t vebar[3] = {0, pbar, 1-pbar};
+   const Double_t vx[3] = {(1-p)/2, 0, (1+p)/2};
+   const Double_t vxbar[3] = {0, (1-pbar)/2, (1+pbar)/2};
+   SetWeights(1, ve);
+   SetWeights(2, vebar);
+   for (UShort_t type=3; type<=6; type+=2) {
+      SetWeights(type, vx);
+      SetWeights(type+1, vxbar);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::FlavorView::SetWeights(UShort_t type, const Double_t *weights)
+{
+   if (!IsValid(type)) return;
+   copy(weights, weights+3, fWeights[type]);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::N2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   const SpectrumGrid *grid = fModel->Grid();
+   if (!IsValid(type) || !grid) return 0;
+   return grid->Mix(SpectrumGrid::kNumber, fWeights[type], time, energy);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::L2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   const SpectrumGrid *grid = fModel->Grid();
+   if (!IsValid(type) || !grid) return 0;
+   return grid->Mix(SpectrumGrid::kLuminosity, fWeights[type], time, energy);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::FlavorView::N2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   const SpectrumGrid *grid = fModel->Grid();
+   if (!IsValid(type) || !grid) { fill(result, result+n, 0.); return; }
+   grid->Mix(SpectrumGrid::kNumber, fWeights[type], time, energy, result, n);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::FlavorView::L2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   const SpectrumGrid *grid = fModel->Grid();
+   if (!IsValid(type) || !grid) { fill(result, result+n, 0.); return; }
+   grid->Mix(SpectrumGrid::kLuminosity, fWeights[type], time, energy,
+         result, n);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::Nt(UShort_t type, Double_t time,
+      Double_t emax) const
+{
+   return Sum(type, [&](UShort_t i) { return fModel->Nt(i, time, emax); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::Ne(UShort_t type, Double_t energy,
+      Double_t tmax) const
+{
+   return Sum(type, [&](UShort_t i) { return fModel->Ne(i, energy, tmax); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::Nall(UShort_t type) const
+{
+   return Sum(type, [&](UShort_t i) { return fModel->Nall(i); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::Lall(UShort_t type) const
+{
+   return Sum(type, [&](UShort_t i) { return fModel->Lall(i); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::FlavorView::Eave(UShort_t type) const
+{
+   Double_t n = Nall(type);
+   return n>0 ? Lall(type)/n/1.60217646e-6 : 0;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,94 @@
+#ifndef FLAVORVIEW_H
+#define FLAVORVIEW_H
+
+#include "SupernovaModel.h"
+
+namespace NEUS { class FlavorView; }
+
+/**
+ * Spectra of a loaded model seen after flavor transformation.
+ * Each of the 6 types of neutrinos, see SupernovaModel, is a fixed linear
+ * combination of the v_e, anti-v_e and v_x spectra of the model, e.g. the
+ * v_e reaching a detector is p*F_e + (1-p)*F_x, where p is the survival
+ * probability of v_e and F_x the spectrum of each of v_mu, v_tau. All
+ * quantities are computed on the fly from the data of the model, which is
+ * neither copied nor changed, so any number of views can share one model.
+ * The model must outlive its views.
+ *
+ * Scenarios (Dighe and Smirnov, Phys. Rev. D 62 (2000) 033007):
+ * kNoOscillation: p = 1, pbar = 1.
+ * kNormal: adiabatic MSW in normal ordering, p = sin^2(theta13),
+ *          pbar = cos^2(theta12) cos^2(theta13).
+ * kInverted: adiabatic MSW in inverted ordering,
+ *          p = sin^2(theta12) cos^2(theta13), pbar = sin^2(theta13).
+ * kSwap: complete exchange of v_e and v_x, p = 0, pbar = 0.
+ *
+ * Queries are const and can be called from many threads at the same time,
+ * as those of SupernovaModel. Types other than 1 to 6 give 0.
+ */
+class NEUS::FlavorView
+{
+   public:
+      enum EScenario { kNoOscillation=0, kNormal, kInverted, kSwap };
+      static const Double_t fgSin2Theta12; // PDG 2022
+      static const Double_t fgSin2Theta13;
+
+   private:
+      const SupernovaModel *fModel;
+      /**
+       * Weights of v_e, anti-v_e and v_x of the model in each type,
+       * indexed as SpectrumGrid::Flavor().
+       */
+      Double_t fWeights[SupernovaModel::fgNtype][3];
+
+      Bool_t IsValid(UShort_t type) const { return type>=1 && type<=6; }
+      /**
+       * Sum of weights of type times f(source type) for source types 1 to
+       * 3, skipping weights of 0.
+       */
+      template<typename F> Double_t Sum(UShort_t type, F f) const
+      {
+         if (!IsValid(type)) return 0;
+         Double_t sum = 0;
+         for (UShort_t i=0; i<3; i++)
+            if (fWeights[type][i]!=0) sum += fWeights[type][i]*f(i+1);
+         return sum;
+      }
+
+   public:
+      explicit FlavorView(const SupernovaModel &model,
+            EScenario scenario=kNoOscillation);
+
+      const SupernovaModel& Model() const { return *fModel; }
+
+      void SetScenario(EScenario scenario);
+      /**
+       * Survival probabilities of v_e and anti-v_e. v_mu and v_tau share
+       * what v_e and anti-v_e lose, so that the total number of neutrinos
+       * is kept.
+       */
+      void SetSurvival(Double_t p, Double_t pbar);
+      /**
+       * Any other combination: type is weights[0]*F_e + weights[1]*F_ebar
+       * + weights[2]*F_x.
+       */
+      void SetWeights(UShort_t type, const Double_t *weights);
+      const Double_t* Weights(UShort_t type) const { return fWeights[type]; }
+
+      /**
+       * Same as those of SupernovaModel, for the transformed spectra.
+       */
+      Double_t N2(UShort_t type, Double_t time, Double_t energy) const;
+      Double_t L2(UShort_t type, Double_t time, Double_t energy) const;
+      void N2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, size_t n) const;
+      void L2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, size_t n) const;
+      Double_t Nt(UShort_t type, Double_t time, Double_t emax=999.) const;
+      Double_t Ne(UShort_t type, Double_t energy, Double_t tmax=999.) const;
+      Double_t Nall(UShort_t type) const;
+      Double_t Lall(UShort_t type) const;
+      Double_t Eave(UShort_t type) const;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include "GridBuilder.h"
+
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+namespace {
+   const unsigned short kInitialT = 32; // time bins to start with
+   const unsigned short kInitialE = 16; // energy bins to start with
+   const unsigned short kProbes = 16; // probe times for energy bins
+   const unsigned short kMaxBins = 4096; // on each axis
+   const unsigned short kRounds = 4; // fills checking cells
+   const double kMinWidth = 1e-6; // of the range of an axis
+
+   void Centers(const vector<double> &edges, vector<double> &centers)
+   {
+      centers.resize(edges.size()-1);
+      for (size_t i=0; i+1<edges.size(); i++)
+         centers[i] = (edges[i]+edges[i+1])/2;
+   }
+
+   const size_t kNew = size_t(-1); // bin without values yet
+
+   // cut flagged bins in halves, map gives the bin each new bin was, or
+   // kNew for halves
+   void Split(vector<double> &edges, const vector<bool> &split,
+         vector<size_t> &map)
+   {
+      vector<double> result(1, edges[0]);
+      map.clear();
+      for (size_t i=0; i+1<edges.size(); i++) {
+         if (split[i]) {
+            result.push_back((edges[i]+edges[i+1])/2);
+            map.push_back(kNew);
+            map.push_back(kNew);
+         } else map.push_back(i);
+         result.push_back(edges[i+1]);
+      }
+      edges.swap(result);
+   }
+
+   void Split(vector<double> &edges, const vector<bool> &split)
+   {
+      vector<size_t> map;
+      Split(edges, split, map);
+   }
+
+   // bins before Split() gave map, each cut bin giving two
+   size_t Before(const vector<size_t> &map)
+   {
+      return map.size()-count(map.begin(), map.end(), kNew)/2;
+   }
+}
+
+const double NEUS::GridBuilder::fgFloor = 1e-3;
+
+//______________________________________________________________________________
+//
+
+NEUS::GridBuilder::GridBuilder(const Function &f, unsigned short nvalues) :
+   fFunction(f), fNvalues(nvalues), fTolerance(0), fEdgesT(), fEdgesE(),
+   fValues(), fMids(), fScale(), fError(0), fNcalls(0) {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridBuilder::Evaluate(const vector<double> &t,
+      const vector<double> &e, vector<double> &values)
+{
+   values.resize(t.size()*fNvalues);
+   if (t.empty()) return;
+   fFunction(t.size(), &t[0], &e[0], &values[0]);
+   fNcalls += t.size();
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::GridBuilder::Error(const double *a, const double *b,
+      const double *mid, size_t probes) const
+{
+   double error = 0;
+   for (size_t p=0; p<probes; p++)
+      for (unsigned short k=0; k<fNvalues; k++) {
+         size_t i = p*fNvalues+k;
+         double scale = max(fabs(mid[i]), fScale[k]);
+         if (scale>0) error = max(error, fabs((a[i]+b[i])/2-mid[i])/scale);
+      }
+   return error;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::GridBuilder::Build(double tmin, double tmax, double emin,
+      double emax, double tolerance)
+{
+   fTolerance = tolerance;
+   fError = 0;
+   fNcalls = 0;
+   fEdgesT.resize(kInitialT+1);
+   for (unsigned short i=0; i<=kInitialT; i++)
+      fEdgesT[i] = tmin>0 ? tmin*pow(tmax/tmin, double(i)/kInitialT)
+         : tmin+(tmax-tmin)*i/kInitialT;
+   fEdgesE.resize(kInitialE+1);
+   for (unsigned short i=0; i<=kInitialE; i++)
+      fEdgesE[i] = emin+(emax-emin)*i/kInitialE;
+   fEdgesT.back() = tmax;
+   fEdgesE.back() = emax;
+
+   // maximum of each function on the coarse grid
+   vector<double> ct, ce, t, e, values;
+   Centers(fEdgesT, ct);
+   Centers(fEdgesE, ce);
+   for (size_t it=0; it<ct.size(); it++)
+      for (size_t ie=0; ie<ce.size(); ie++) {
+         t.push_back(ct[it]);
+         e.push_back(ce[ie]);
+      }
+   fScale.assign(fNvalues, 0.);
+   Evaluate(t, e, values);
+   for (size_t i=0; i<values.size(); i++)
+      fScale[i%fNvalues] = max(fScale[i%fNvalues], fabs(values[i]));
+   for (unsigned short k=0; k<fNvalues; k++) fScale[k] *= fgFloor;
+
+   // time bins at the coarse energies, then energy bins at times spread
+   // over the refined time bins
+   Refine(fEdgesT, true, ce);
+   Centers(fEdgesT, ct);
+   vector<double> probes;
+   for (unsigned short i=0; i<kProbes; i++)
+      probes.push_back(ct[(ct.size()-1)*i/(kProbes-1)]);
+   Refine(fEdgesE, false, probes);
+
+   // check all cells, evaluating only new centers and cells after a cut
+   vector<size_t> mapT, mapE;
+   fValues.clear();
+   fMids.clear();
+   for (unsigned short round=0; ; round++) {
+      vector<bool> failedT, failedE;
+      Fill(mapT, mapE, failedT, failedE);
+      if (fError<=fTolerance || round+1>=kRounds) break;
+      size_t nt = count(failedT.begin(), failedT.end(), true);
+      size_t ne = count(failedE.begin(), failedE.end(), true);
+      if (nt+ne==0 || TBins()+nt>kMaxBins || EBins()+ne>kMaxBins) break;
+      Split(fEdgesT, failedT, mapT);
+      Split(fEdgesE, failedE, mapE);
+   }
+   return fError<=fTolerance;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridBuilder::Refine(vector<double> &edges, bool isTime,
+      const vector<double> &probes)
+{
+   const size_t np = probes.size(), stride = np*fNvalues;
+   const double minWidth = (edges.back()-edges.front())*kMinWidth;
+
+   // values at the center of each bin for each probe
+   vector<double> centers, t, e, values;
+   Centers(edges, centers);
+   for (size_t i=0; i<centers.size(); i++)
+      for (size_t p=0; p<np; p++) {
+         t.push_back(isTime ? centers[i] : probes[p]);
+         e.push_back(isTime ? probes[p] : centers[i]);
+      }
+   Evaluate(t, e, values);
+   vector<bool> checked(centers.size()-1, false); // in between bins i, i+1
+
+   while (true) {
+      // middle of unchecked pairs of centers
+      vector<size_t> pairs;
+      t.clear();
+      e.clear();
+      for (size_t i=0; i<checked.size(); i++) {
+         if (checked[i]) continue;
+         pairs.push_back(i);
+         double mid = (centers[i]+centers[i+1])/2;
+         for (size_t p=0; p<np; p++) {
+            t.push_back(isTime ? mid : probes[p]);
+            e.push_back(isTime ? probes[p] : mid);
+         }
+      }
+      if (pairs.empty()) return;
+      vector<double> mids;
+      Evaluate(t, e, mids);
+
+      // cut both bins of pairs missing the tolerance, as long as they are
+      // wider than the minimal width
+      vector<bool> split(centers.size(), false);
+      size_t nsplit = 0;
+      for (size_t j=0; j<pairs.size(); j++) {
+         size_t i = pairs[j];
+         checked[i] = true;
+         if (Error(&values[i*stride], &values[(i+1)*stride], &mids[j*stride],
+                  np)<=fTolerance) continue;
+         for (size_t b=i; b<=i+1; b++) {
+            if (split[b] || edges[b+1]-edges[b]<2*minWidth) continue;
+            split[b] = true;
+            checked[i] = false;
+            nsplit++;
+         }
+      }
+      if (nsplit==0 || centers.size()+nsplit>kMaxBins) return;
+
+      // new bins, keeping values and checks of bins that are not cut
+      vector<double> newEdges(edges);
+      Split(newEdges, split);
+      vector<double> newCenters, newValues;
+      Centers(newEdges, newCenters);
+      newValues.resize(newCenters.size()*stride);
+      vector<bool> newChecked(newCenters.size()-1, false);
+      vector<size_t> pending; // new bins without values
+      t.clear();
+      e.clear();
+      for (size_t i=0, n=0; i<centers.size(); i++) {
+         if (!split[i]) {
+            copy(values.begin()+i*stride, values.begin()+(i+1)*stride,
+                  newValues.begin()+n*stride);
+            if (i+1<centers.size() && !split[i+1])
+               newChecked[n] = checked[i];
+            n++;
+            continue;
+         }
+         for (size_t half=0; half<2; half++, n++) {
+            pending.push_back(n);
+            for (size_t p=0; p<np; p++) {
+               t.push_back(isTime ? newCenters[n] : probes[p]);
+               e.push_back(isTime ? probes[p] : newCenters[n]);
+            }
+         }
+      }
+      vector<double> added;
+      Evaluate(t, e, added);
+      for (size_t j=0; j<pending.size(); j++)
+         copy(added.begin()+j*stride, added.begin()+(j+1)*stride,
+               newValues.begin()+pending[j]*stride);
+
+      edges.swap(newEdges);
+      centers.swap(newCenters);
+      values.swap(newValues);
+      checked.swap(newChecked);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridBuilder::Fill(const vector<size_t> &mapT,
+      const vector<size_t> &mapE, vector<bool> &failedT,
+      vector<bool> &failedE)
+{
+   const size_t nt = TBins(), ne = EBins(), nv = fNvalues;
+   const bool kept = !mapT.empty() && !mapE.empty();
+   const size_t oldNt = kept ? Before(mapT) : 0;
+   const size_t oldNe = kept ? Before(mapE) : 0;
+   vector<double> ct, ce, t, e, values;
+   Centers(fEdgesT, ct);
+   Centers(fEdgesE, ce);
+
+   // new centers, then the middle of new cells in between four centers;
+   // a cell is new unless its four bins were neighbours before
+   auto known = [&](size_t it, size_t ie) {
+      return kept && mapT[it]!=kNew && mapE[ie]!=kNew; };
+   auto knownCell = [&](size_t it, size_t ie) {
+      return known(it, ie) && mapT[it+1]==mapT[it]+1
+         && mapE[ie+1]==mapE[ie]+1; };
+   vector<size_t> centers, cells; // it*ne+ie and it*(ne-1)+ie
+   for (size_t it=0; it<nt; it++)
+      for (size_t ie=0; ie<ne; ie++) {
+         if (known(it, ie)) continue;
+         centers.push_back(it*ne+ie);
+         t.push_back(ct[it]);
+         e.push_back(ce[ie]);
+      }
+   for (size_t it=0; it+1<nt; it++)
+      for (size_t ie=0; ie+1<ne; ie++) {
+         if (knownCell(it, ie)) continue;
+         cells.push_back(it*(ne-1)+ie);
+         t.push_back((ct[it]+ct[it+1])/2);
+         e.push_back((ce[ie]+ce[ie+1])/2);
+      }
+   Evaluate(t, e, values);
+
+   // values kept from the last fill, then new ones
+   vector<double> newValues(nv*nt*ne), newMids(nv*(nt-1)*(ne-1));
+   for (size_t it=0; it<nt; it++)
+      for (size_t ie=0; ie<ne; ie++) {
+         if (!known(it, ie)) continue;
+         for (size_t k=0; k<nv; k++) newValues[(k*nt+it)*ne+ie]
+            = fValues[(k*oldNt+mapT[it])*oldNe+mapE[ie]];
+      }
+   for (size_t it=0; it+1<nt; it++)
+      for (size_t ie=0; ie+1<ne; ie++) {
+         if (!knownCell(it, ie)) continue;
+         copy(fMids.begin()+(mapT[it]*(oldNe-1)+mapE[ie])*nv,
+               fMids.begin()+(mapT[it]*(oldNe-1)+mapE[ie]+1)*nv,
+               newMids.begin()+(it*(ne-1)+ie)*nv);
+      }
+   for (size_t j=0; j<centers.size(); j++)
+      for (size_t k=0; k<nv; k++)
+         newValues[k*nt*ne+centers[j]] = values[j*nv+k];
+   const double *added = values.data()+centers.size()*nv;
+   for (size_t j=0; j<cells.size(); j++)
+      copy(added+j*nv, added+(j+1)*nv, newMids.begin()+cells[j]*nv);
+   fValues.swap(newValues);
+   fMids.swap(newMids);
+
+   // error of interpolating a center from its neighbours along an axis,
+   // which tells the direction in which a cell has to be cut
+   auto miss = [&](size_t k, size_t it, size_t ie, bool isTime) {
+      const vector<double> &c = isTime ? ct : ce;
+      size_t i = isTime ? it : ie, n = c.size();
+      if (n<3) return 0.;
+      i = min(max(i, size_t(1)), n-2);
+      size_t step = isTime ? ne : 1;
+      const double *v = &fValues[k*nt*ne + (isTime ? i*ne+ie : it*ne+i)];
+      double w = (c[i]-c[i-1])/(c[i+1]-c[i-1]);
+      return fabs(v[0]-((1-w)*v[-(long)step]+w*v[step]));
+   };
+
+   fError = 0;
+   failedT.assign(nt, false);
+   failedE.assign(ne, false);
+   const double *mids = fMids.data();
+   for (size_t it=0; it+1<nt; it++)
+      for (size_t ie=0; ie+1<ne; ie++) {
+         const double *mid = mids + (it*(ne-1)+ie)*nv;
+         double error = 0, missT = 0, missE = 0;
+         for (size_t k=0; k<nv; k++) {
+            const double *v = &fValues[k*nt*ne + it*ne+ie];
+            double average = (v[0]+v[1]+v[ne]+v[ne+1])/4;
+            double scale = max(fabs(mid[k]), fScale[k]);
+            if (!(scale>0)) continue;
+            error = max(error, fabs(average-mid[k])/scale);
+            missT = max(missT, max(miss(k, it, ie, true),
+                     miss(k, it+1, ie+1, true))/scale);
+            missE = max(missE, max(miss(k, it, ie, false),
+                     miss(k, it+1, ie+1, false))/scale);
+         }
+         fError = max(fError, error);
+         if (error<=fTolerance) continue;
+         if (missT>=missE/2) failedT[it] = failedT[it+1] = true;
+         if (missE>=missT/2) failedE[ie] = failedE[ie+1] = true;
+      }
+
+   // bins that cannot be cut any more
+   const double minT = (fEdgesT.back()-fEdgesT.front())*kMinWidth;
+   const double minE = (fEdgesE.back()-fEdgesE.front())*kMinWidth;
+   for (size_t it=0; it<nt; it++)
+      if (fEdgesT[it+1]-fEdgesT[it]<2*minT) failedT[it] = false;
+   for (size_t ie=0; ie<ne; ie++)
+      if (fEdgesE[ie+1]-fEdgesE[ie]<2*minE) failedE[ie] = false;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,114 @@
+#ifndef GRIDBUILDER_H
+#define GRIDBUILDER_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+namespace NEUS { class GridBuilder; }
+
+/**
+ * Adaptive binning of functions of time and energy.
+ * The functions are sampled at bin centers, between which SpectrumGrid
+ * interpolates linearly. Starting from a coarse binning, bins are cut in
+ * halves where linear interpolation between neighbouring centers misses
+ * the functions by more than a relative tolerance, first along time for a
+ * few probe energies, then along energy for a few probe times. The
+ * resulting grid is filled and the interpolation error is measured in the
+ * middle of every cell in between four centers; time and energy bins of
+ * the cells that fail are cut again, up to a few times, and only the new
+ * centers and cells are evaluated again.
+ *
+ * Errors are relative to the value of a function, but values smaller than
+ * fgFloor of its maximum count as fgFloor of its maximum, so that tails
+ * falling to 0 do not need infinitely many bins.
+ * This class does not depend on ROOT.
+ */
+class NEUS::GridBuilder
+{
+   public:
+      /**
+       * Values of nvalues functions at n points (t[i], e[i]), saved in
+       * values[i*nvalues+k]. It is called with batches of points, which it
+       * may evaluate in parallel.
+       */
+      typedef std::function<void(std::size_t n, const double *t,
+            const double *e, double *values)> Function;
+      static const double fgFloor;
+
+   private:
+      Function fFunction;
+      unsigned short fNvalues;
+      double fTolerance;
+      std::vector<double> fEdgesT, fEdgesE;
+      std::vector<double> fValues; // see Values()
+      // values in the middle of cells between four centers, point-major
+      std::vector<double> fMids;
+      std::vector<double> fScale; // fgFloor of the maximum of each function
+      double fError;
+      std::size_t fNcalls;
+
+      void Evaluate(const std::vector<double> &t, const std::vector<double> &e,
+            std::vector<double> &values);
+      /**
+       * Largest error of interpolating between centers a and b to mid,
+       * for probes*fNvalues values of each.
+       */
+      double Error(const double *a, const double *b, const double *mid,
+            std::size_t probes) const;
+      /**
+       * Cut bins of edges, the time axis if isTime, at the given
+       * coordinates of the other axis until interpolation along the axis
+       * meets the tolerance.
+       */
+      void Refine(std::vector<double> &edges, bool isTime,
+            const std::vector<double> &probes);
+      /**
+       * Fill fValues and fMids and measure fError, flagging the bins on
+       * both sides of the cells that fail. mapT and mapE give the bin of
+       * the last fill that each bin was, as Refine() keeps values of bins
+       * that are not cut; only new centers and cells are evaluated. They
+       * are empty for the first fill.
+       */
+      void Fill(const std::vector<std::size_t> &mapT,
+            const std::vector<std::size_t> &mapE, std::vector<bool> &failedT,
+            std::vector<bool> &failedE);
+
+   public:
+      /**
+       * The functions evaluated by f, nvalues at each point.
+       */
+      GridBuilder(const Function &f, unsigned short nvalues);
+
+      /**
+       * Build a grid in [tmin, tmax] x [emin, emax] so that the relative
+       * error of interpolation stays below tolerance. Time bins start
+       * equally spaced in log(t) if tmin>0, energy bins equally spaced.
+       * False is returned if the tolerance is not met within the maximal
+       * number of bins, in which case Error() tells how far it is.
+       */
+      bool Build(double tmin, double tmax, double emin, double emax,
+            double tolerance);
+
+      const std::vector<double>& TimeEdges() const { return fEdgesT; }
+      const std::vector<double>& EnergyEdges() const { return fEdgesE; }
+      /**
+       * Values at bin centers, function-major, then time-major:
+       * bin (it, ie) of function k is at [(k*TBins()+it)*EBins()+ie], which
+       * is the layout of SpectrumGrid::Content().
+       */
+      const std::vector<double>& Values() const { return fValues; }
+      unsigned short TBins() const { return fEdgesT.size()-1; }
+      unsigned short EBins() const { return fEdgesE.size()-1; }
+      /**
+       * Largest relative error of interpolation measured in the middle of
+       * all cells in the final grid.
+       */
+      double Error() const { return fError; }
+      /**
+       * Number of points at which the functions have been evaluated.
+       */
+      std::size_t GetNcalls() const { return fNcalls; }
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include "GridFile.h"
+#include "SpectrumGrid.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+namespace {
+   const char kMagic[8] = {'N','E','U','S','G','R','I','D'};
+   const uint32_t kByteOrder = 0x01020304;
+   const uint64_t kAlignment = 64;
+
+   struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byteOrder; // kByteOrder written in native byte order
+      uint16_t nbinsT, nbinsE, nbinsI, reserved;
+      // offsets of sections in bytes, 0 if a section does not exist
+      uint64_t edgesT, edgesE, content, edgesI, integrated;
+      uint64_t checksum; // of the source data, 0 if unknown
+      double error; // of interpolating the grid, 0 if unknown
+      uint64_t size; // size of the file
+   };
+
+   uint64_t Align(uint64_t offset)
+   { return (offset+kAlignment-1)/kAlignment*kAlignment; }
+
+#ifndef _WIN32
+   // unmap the file when the last user is gone
+   struct Mapping {
+      void *address;
+      size_t length;
+      ~Mapping() { munmap(address, length); }
+   };
+#endif
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::GridFile::GridFile() : fMap(), fBase(0), fError(), fChecksum(0),
+   fInterpolationError(0), fNbinsT(0), fNbinsE(0), fNbinsI(0), fEdgesT(0),
+   fEdgesE(0), fContent(0), fEdgesI(0), fIntegrated(0) {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridFile::Close()
+{
+   fMap.reset();
+   fBase = 0;
+   fChecksum = 0;
+   fInterpolationError = 0;
+   fNbinsT = fNbinsE = fNbinsI = 0;
+   fEdgesT = fEdgesE = fContent = fEdgesI = fIntegrated = 0;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::GridFile::Open(const char *path)
+{
+   Close();
+   fError = "";
+
+   size_t length = 0;
+#ifndef _WIN32
+   int fd = open(path, O_RDONLY);
+   if (fd<0) { fError = string(path)+" cannot be opened"; return false; }
+   struct stat status;
+   if (fstat(fd, &status)!=0 || status.st_size<(off_t)sizeof(Header)) {
+      close(fd);
+      fError = string(path)+" is too short";
+      return false;
+   }
+   length = status.st_size;
+   void *address = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd); // the mapping stays valid
+   if (address==MAP_FAILED) {
+      fError = string(path)+" cannot be mapped";
+      return false;
+   }
+   shared_ptr<Mapping> mapping(new Mapping);
+   mapping->address = address;
+   mapping->length = length;
+   fMap = shared_ptr<const void>(mapping, address);
+#else
+   // no mmap, read the file into an aligned buffer instead
+   ifstream file(path, ios::binary|ios::ate);
+   if (!file.is_open()) {
+      fError = string(path)+" cannot be opened";
+      return false;
+   }
+   length = file.tellg();
+   if (length<sizeof(Header)) {
+      fError = string(path)+" is too short";
+      return false;
+   }
+   char *buffer = static_cast<char*>(
+         _aligned_malloc(Align(length), kAlignment));
+   file.seekg(0);
+   file.read(buffer, length);
+   fMap = shared_ptr<const void>(buffer, [](const void *p) {
+         _aligned_free(const_cast<void*>(p)); });
+#endif
+   const char *base = static_cast<const char*>(fMap.get());
+
+   // validate header
+   Header header;
+   memcpy(&header, base, sizeof(Header));
+   if (memcmp(header.magic, kMagic, sizeof(kMagic))!=0)
+      fError = string(path)+" is not a NEUS grid file";
+   else if (header.byteOrder!=kByteOrder)
+      fError = string(path)+" is written in a different byte order";
+   else if (header.version!=fgVersion) {
+      char message[64];
+      snprintf(message, sizeof(message), " has version %u instead of %u",
+            header.version, fgVersion);
+      fError = string(path)+message;
+   } else if (header.size!=length)
+      fError = string(path)+" is truncated";
+   if (!fError.empty()) { Close(); return false; }
+
+   // sections must be inside the file
+   uint64_t sizes[5] = {
+      (header.nbinsT+1u)*sizeof(double),
+      (header.nbinsE+1u)*sizeof(double),
+      uint64_t(SpectrumGrid::fgNquantity)*SpectrumGrid::fgNflavor
+         *header.nbinsT*header.nbinsE*sizeof(double),
+      (header.nbinsI+1u)*sizeof(double),
+      6u*header.nbinsI*sizeof(double) };
+   uint64_t offsets[5] = {header.edgesT, header.edgesE, header.content,
+      header.edgesI, header.integrated};
+   for (int i=0; i<5; i++) {
+      if (offsets[i]==0) continue;
+      if (offsets[i]%kAlignment!=0 || offsets[i]+sizes[i]>length) {
+         fError = string(path)+" has a corrupted header";
+         Close();
+         return false;
+      }
+   }
+
+   fBase = base;
+   fChecksum = header.checksum;
+   fInterpolationError = header.error;
+   if (header.content && header.edgesT && header.edgesE) {
+      fNbinsT = header.nbinsT;
+      fNbinsE = header.nbinsE;
+      fEdgesT = reinterpret_cast<const double*>(base+header.edgesT);
+      fEdgesE = reinterpret_cast<const double*>(base+header.edgesE);
+      fContent = reinterpret_cast<const double*>(base+header.content);
+   }
+   if (header.integrated && header.edgesI) {
+      fNbinsI = header.nbinsI;
+      fEdgesI = reinterpret_cast<const double*>(base+header.edgesI);
+      fIntegrated = reinterpret_cast<const double*>(base+header.integrated);
+   }
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::GridFile::MapGrid(SpectrumGrid &grid) const
+{
+   if (!HasGrid()) return false;
+   grid.Adopt(fNbinsT, fEdgesT, fNbinsE, fEdgesE, fContent, fMap);
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+string NEUS::GridFile::Write(const char *path, const SpectrumGrid *grid,
+      unsigned short nbinsI, const double *edgesI, const double *integrated,
+      unsigned long long checksum, double error)
+{
+   Header header;
+   memset(&header, 0, sizeof(Header));
+   memcpy(header.magic, kMagic, sizeof(kMagic));
+   header.version = fgVersion;
+   header.byteOrder = kByteOrder;
+   header.checksum = checksum;
+   header.error = error;
+
+   uint64_t offset = Align(sizeof(Header));
+   if (grid && !grid->IsEmpty()) {
+      header.nbinsT = grid->TBins();
+      header.nbinsE = grid->EBins();
+      header.edgesT = offset;
+      offset = Align(offset + (header.nbinsT+1u)*sizeof(double));
+      header.edgesE = offset;
+      offset = Align(offset + (header.nbinsE+1u)*sizeof(double));
+      header.content = offset;
+      offset = Align(offset + grid->Size()*sizeof(double));
+   }
+   if (nbinsI>0 && edgesI && integrated) {
+      header.nbinsI = nbinsI;
+      header.edgesI = offset;
+      offset = Align(offset + (nbinsI+1u)*sizeof(double));
+      header.integrated = offset;
+      offset = Align(offset + 6u*nbinsI*sizeof(double));
+   }
+   header.size = offset;
+
+   vector<char> buffer(offset, 0);
+   memcpy(&buffer[0], &header, sizeof(Header));
+   if (header.content) {
+      memcpy(&buffer[header.edgesT], grid->TimeAxis().Edges(),
+            (header.nbinsT+1u)*sizeof(double));
+      memcpy(&buffer[header.edgesE], grid->EnergyAxis().Edges(),
+            (header.nbinsE+1u)*sizeof(double));
+      // contents of each quantity and flavor, in any storage
+      vector<double> contents;
+      const size_t n = size_t(header.nbinsT)*header.nbinsE;
+      char *p = &buffer[header.content];
+      for (unsigned short q=0; q<SpectrumGrid::fgNquantity; q++)
+         for (unsigned short f=0; f<SpectrumGrid::fgNflavor; f++) {
+            memcpy(p, grid->Content(SpectrumGrid::EQuantity(q), f, contents),
+                  n*sizeof(double));
+            p += n*sizeof(double);
+         }
+   }
+   if (header.integrated) {
+      memcpy(&buffer[header.edgesI], edgesI, (nbinsI+1u)*sizeof(double));
+      memcpy(&buffer[header.integrated], integrated,
+            6u*nbinsI*sizeof(double));
+   }
+
+   // write to a temporary file and rename it, so that jobs mapping the old
+   // file are not affected and never see a partially written one
+   string temporary = string(path)+".tmp";
+   ofstream file(temporary.c_str(), ios::binary|ios::trunc);
+   if (!file.is_open()) return temporary+" cannot be created";
+   file.write(&buffer[0], buffer.size());
+   file.close();
+   if (!file) return temporary+" cannot be written";
+   if (rename(temporary.c_str(), path)!=0)
+      return string(path)+" cannot be created";
+   return "";
+}
+
+//______________________________________________________________________________
+//
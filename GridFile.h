@@ -0,0 +1,109 @@
+#ifndef GRIDFILE_H
+#define GRIDFILE_H
+
+#include <memory>
+#include <string>
+
+namespace NEUS { class GridFile; class SpectrumGrid; }
+
+/**
+ * Binary file holding the data of a model.
+ * It contains N(t, E) and L(t, E) in the layout of SpectrumGrid, and
+ * optionally the time-integrated N(E) and L(E) of all three flavors. All
+ * values are divided by 1e50 as in the histograms.
+ *
+ * The file is memory-mapped read-only. Contents of a SpectrumGrid can point
+ * directly to the mapped pages, so that nothing is parsed or copied when a
+ * model is loaded and all processes on a machine share one copy of the data.
+ *
+ * The header carries a checksum of the source data, which a model computed
+ * from something else than ASCII files, such as LivermoreModel, compares
+ * with that of its current source to tell whether the file is stale.
+ *
+ * Layout (native byte order, every section starts at a 64-byte boundary):
+ * header, time bin edges, energy bin edges, N/L(t, E), edges of the
+ * integrated energy bins, N/L(E) of v_e, anti-v_e, v_x.
+ */
+class NEUS::GridFile
+{
+   public:
+      /**
+       * Version of the file format.
+       * It has to be increased whenever the layout is changed.
+       */
+      static const unsigned int fgVersion = 3;
+
+   private:
+      std::shared_ptr<const void> fMap; // mapped file
+      const char *fBase; // beginning of the mapped file
+      std::string fError; // why the file cannot be used
+
+      unsigned long long fChecksum; // of the source data, 0 if unknown
+      double fInterpolationError; // of the grid, 0 if unknown
+      unsigned short fNbinsT, fNbinsE, fNbinsI;
+      const double *fEdgesT, *fEdgesE, *fContent;
+      const double *fEdgesI, *fIntegrated;
+
+   public:
+      GridFile();
+      ~GridFile() { Close(); }
+
+      /**
+       * Map a file.
+       * False is returned if the file does not exist or is not valid, see
+       * Error() for the reason.
+       */
+      bool Open(const char *path);
+      void Close();
+      bool IsOpen() const { return fBase!=0; }
+      const char* Error() const { return fError.c_str(); }
+      /**
+       * Checksum of the source data given to Write(), 0 if none is given.
+       */
+      unsigned long long Checksum() const { return fChecksum; }
+      /**
+       * Relative error of interpolating the grid given to Write(), 0 if
+       * it is not known.
+       */
+      double InterpolationError() const { return fInterpolationError; }
+
+      bool HasGrid() const { return fContent!=0; }
+      /**
+       * Let grid use the mapped N(t, E) and L(t, E) without copying them.
+       * The mapping stays alive as long as grid uses it, even if this object
+       * is closed or deleted.
+       */
+      bool MapGrid(SpectrumGrid &grid) const;
+
+      bool HasIntegrated() const { return fIntegrated!=0; }
+      unsigned short IntegratedBins() const { return fNbinsI; }
+      const double* IntegratedEdges() const { return fEdgesI; }
+      const double* TimeEdges() const { return fEdgesT; }
+      const double* EnergyEdges() const { return fEdgesE; }
+      unsigned short TBins() const { return fNbinsT; }
+      unsigned short EBins() const { return fNbinsE; }
+      /**
+       * Time-integrated spectrum of a quantity (SpectrumGrid::EQuantity)
+       * for a flavor (0: v_e, 1: anti-v_e, 2: v_x).
+       */
+      const double* Integrated(unsigned short quantity,
+            unsigned short flavor) const
+      { return fIntegrated + (quantity*3+flavor)*fNbinsI; }
+
+      /**
+       * Save a grid and time-integrated spectra to path.
+       * grid may be NULL if only integrated spectra exist. Integrated
+       * spectra are skipped if nbinsI is 0; otherwise integrated points to
+       * 6*nbinsI values: N(E) of v_e, anti-v_e, v_x, then L(E) of them.
+       * checksum identifies the data they are made from, see Checksum(),
+       * and error is that of InterpolationError().
+       * An empty string is returned on success, otherwise the reason of
+       * the failure.
+       */
+      static std::string Write(const char *path, const SpectrumGrid *grid,
+            unsigned short nbinsI=0, const double *edgesI=0,
+            const double *integrated=0, unsigned long long checksum=0,
+            double error=0);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "HistogramCache.h"
+
+#include <TH1D.h>
+using namespace std;
+
+//______________________________________________________________________________
+//
+
+NEUS::HistogramCache::HistogramCache(UInt_t capacity) : fList(), fIndex(),
+   fCapacity(capacity>0 ? capacity : 1), fHits(0), fMisses(0), fMutex() {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::HistogramCache::Shrink(UInt_t n)
+{
+   while (fList.size()>n) {
+      delete fList.back().second;
+      fIndex.erase(fList.back().first);
+      fList.pop_back();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::HistogramCache::Clear()
+{
+   lock_guard<mutex> lock(fMutex);
+   Shrink(0);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::HistogramCache::SetCapacity(UInt_t capacity)
+{
+   lock_guard<mutex> lock(fMutex);
+   fCapacity = capacity>0 ? capacity : 1;
+   Shrink(fCapacity);
+}
+
+//______________________________________________________________________________
+//
+
+UInt_t NEUS::HistogramCache::GetSize() const
+{
+   lock_guard<mutex> lock(fMutex);
+   return fList.size();
+}
+
+//______________________________________________________________________________
+//
+
+ULong64_t NEUS::HistogramCache::GetHits() const
+{
+   lock_guard<mutex> lock(fMutex);
+   return fHits;
+}
+
+//______________________________________________________________________________
+//
+
+ULong64_t NEUS::HistogramCache::GetMisses() const
+{
+   lock_guard<mutex> lock(fMutex);
+   return fMisses;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::HistogramCache::ResetCounters()
+{
+   lock_guard<mutex> lock(fMutex);
+   fHits = fMisses = 0;
+}
+
+//______________________________________________________________________________
+//
+
+ULong64_t NEUS::HistogramCache::GetBytes() const
+{
+   lock_guard<mutex> lock(fMutex);
+   ULong64_t bytes = 0;
+   for (List::const_iterator i=fList.begin(); i!=fList.end(); i++)
+      bytes += (i->second->GetNcells()+i->second->GetSumw2N())*sizeof(Double_t);
+   return bytes;
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* NEUS::HistogramCache::Find(const Key &key)
+{
+   lock_guard<mutex> lock(fMutex);
+   map<Key, List::iterator>::iterator entry = fIndex.find(key);
+   if (entry==fIndex.end()) { fMisses++; return 0; }
+   fHits++;
+   fList.splice(fList.begin(), fList, entry->second);
+   return entry->second->second;
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* NEUS::HistogramCache::Recycle()
+{
+   lock_guard<mutex> lock(fMutex);
+   if (fList.size()<fCapacity) return 0;
+   TH1D *h = fList.back().second;
+   fIndex.erase(fList.back().first);
+   fList.pop_back();
+   return h;
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* NEUS::HistogramCache::Add(const Key &key, TH1D *h)
+{
+   lock_guard<mutex> lock(fMutex);
+   map<Key, List::iterator>::iterator entry = fIndex.find(key);
+   if (entry!=fIndex.end()) {
+      if (entry->second->second!=h) delete h;
+      fList.splice(fList.begin(), fList, entry->second);
+      return entry->second->second;
+   }
+   fList.push_front(make_pair(key, h));
+   fIndex[key] = fList.begin();
+   Shrink(fCapacity);
+   return h;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,103 @@
+#ifndef HISTOGRAMCACHE_H
+#define HISTOGRAMCACHE_H
+
+#include <Rtypes.h>
+
+#include <map>
+#include <list>
+#include <mutex>
+
+class TH1D;
+
+namespace NEUS { class HistogramCache; }
+
+/**
+ * Least-recently-used cache of derived histograms of a model.
+ * Histograms are keyed on the observable, the flavor and the cutoff in
+ * time or energy, compared as numbers. At most GetCapacity() histograms are
+ * kept. When the cache is full, the least recently used one is taken out
+ * by Recycle() to be refilled for a new key, so that scanning cutoffs does
+ * not allocate memory.
+ *
+ * The cache owns its histograms. A histogram returned by SupernovaModel
+ * stays valid until it is evicted or the model is cleared. All functions
+ * can be called from several threads.
+ */
+class NEUS::HistogramCache
+{
+   public:
+      enum EObservable { kNe=0, kLe, kNt, kLt, kEt };
+
+      struct Key {
+         UShort_t observable; // EObservable
+         UShort_t flavor; // see SpectrumGrid::Flavor()
+         Double_t cutoff; // tmax or emax
+         Key(UShort_t o, UShort_t f, Double_t c) :
+            observable(o), flavor(f), cutoff(c) {}
+         bool operator<(const Key &other) const {
+            if (observable!=other.observable)
+               return observable<other.observable;
+            if (flavor!=other.flavor) return flavor<other.flavor;
+            return cutoff<other.cutoff;
+         }
+      };
+
+   private:
+      typedef std::list<std::pair<Key, TH1D*> > List;
+      List fList; // most recently used first
+      std::map<Key, List::iterator> fIndex;
+      UInt_t fCapacity;
+      ULong64_t fHits, fMisses;
+      mutable std::mutex fMutex;
+
+      /**
+       * Delete least recently used histograms beyond n.
+       */
+      void Shrink(UInt_t n);
+
+      HistogramCache(const HistogramCache&);
+      HistogramCache& operator=(const HistogramCache&);
+
+   public:
+      explicit HistogramCache(UInt_t capacity=16);
+      ~HistogramCache() { Clear(); }
+
+      /**
+       * Delete all histograms. Counters are not reset.
+       */
+      void Clear();
+
+      UInt_t GetCapacity() const { return fCapacity; }
+      /**
+       * At least 1 histogram is kept.
+       */
+      void SetCapacity(UInt_t capacity);
+      UInt_t GetSize() const;
+      ULong64_t GetHits() const;
+      ULong64_t GetMisses() const;
+      void ResetCounters();
+      /**
+       * Bytes of bin contents and errors of all cached histograms.
+       */
+      ULong64_t GetBytes() const;
+
+      /**
+       * Histogram cached for key, NULL if there is none.
+       * It counts as a hit or a miss.
+       */
+      TH1D* Find(const Key &key);
+      /**
+       * Take the least recently used histogram out of a full cache, so
+       * that it can be refilled and added for another key. NULL is returned
+       * if the cache is not full. The caller owns the histogram.
+       */
+      TH1D* Recycle();
+      /**
+       * Cache h for key and take ownership of it. If another thread has
+       * cached a histogram for key in the meantime, h is deleted and that
+       * one is returned.
+       */
+      TH1D* Add(const Key &key, TH1D *h);
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "Interpolator.h"
+#include "SpectrumGrid.h"
+
+#include <cmath>
+using namespace std;
+
+namespace {
+   // Hermite basis: coefficients of 1, s, s^2, s^3 from p(0), p(1), p'(0)
+   // and p'(1)
+   const double kHermite[4][4] = {
+      { 1,  0,  0,  0},
+      { 0,  0,  1,  0},
+      {-3,  3, -2, -1},
+      { 2, -2,  1,  1}};
+
+   // sum of a[i*NR+j]*s^i*r^j
+   template<int NS, int NR> double Polynomial(const double *a, double s,
+         double r)
+   {
+      double result = 0;
+      for (int j=NR-1; j>=0; j--) {
+         double c = a[(NS-1)*NR+j];
+         for (int i=NS-2; i>=0; i--) c = c*s + a[i*NR+j];
+         result = result*r + c;
+      }
+      return result;
+   }
+
+   // Slopes dy/dx at n points y[k*stride], from three-point differences,
+   // or from Fritsch-Carlson if monotone. Points where ref is not finite,
+   // i.e. log of a value that is not positive, are skipped.
+   void Slopes(size_t n, const double *x, const double *y, const double *ref,
+         size_t stride, bool monotone, double *m)
+   {
+      vector<double> secant(n-1);
+      vector<bool> valid(n-1);
+      for (size_t k=0; k+1<n; k++) {
+         valid[k] = isfinite(ref[k*stride]) && isfinite(ref[(k+1)*stride]);
+         secant[k] = valid[k] ? (y[(k+1)*stride]-y[k*stride])/(x[k+1]-x[k]) : 0;
+      }
+      for (size_t k=0; k<n; k++) {
+         bool left = k>0 && valid[k-1], right = k+1<n && valid[k];
+         double &slope = m[k*stride];
+         if (left && right) {
+            if (monotone)
+               slope = secant[k-1]*secant[k]>0 ? (secant[k-1]+secant[k])/2 : 0;
+            else {
+               double h0 = x[k]-x[k-1], h1 = x[k+1]-x[k];
+               slope = (h1*secant[k-1]+h0*secant[k])/(h0+h1);
+            }
+         } else if (left) slope = secant[k-1];
+         else if (right) slope = secant[k];
+         else slope = 0;
+      }
+      if (!monotone) return;
+
+      // limit slopes so that each interval stays monotone
+      for (size_t k=0; k+1<n; k++) {
+         double &m0 = m[k*stride], &m1 = m[(k+1)*stride];
+         if (secant[k]==0) { m0 = m1 = 0; continue; }
+         double a = m0/secant[k], b = m1/secant[k];
+         if (a<0) { m0 = 0; a = 0; }
+         if (b<0) { m1 = 0; b = 0; }
+         if (a*a+b*b>9) {
+            double tau = 3/sqrt(a*a+b*b);
+            m0 = tau*a*secant[k];
+            m1 = tau*b*secant[k];
+         }
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::Interpolator::Interpolator() : fMode(kLinear), fTaxis(0), fEaxis(0),
+   fLogT(false), fLogE(false), fT(), fE(), fInvT(), fInvE(), fValues(0),
+   fNs(0), fNr(0), fCoefficients() {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::Interpolator::Clear()
+{
+   fMode = kLinear;
+   fTaxis = fEaxis = 0;
+   fT.clear(); fE.clear(); fInvT.clear(); fInvE.clear();
+   fValues = 0;
+   fCoefficients.clear();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::Interpolator::Set(EMode mode, const GridAxis &taxis,
+      const GridAxis *eaxis, const double *values)
+{
+   Clear();
+   const size_t nt = taxis.GetNbins(), ne = eaxis ? eaxis->GetNbins() : 1;
+   if (mode==kLinear || nt<2 || (eaxis && ne<2)) return;
+
+   const bool logValue = mode==kLogLog || mode==kBicubicLog;
+   const bool cubic = mode==kMonotoneCubic || mode==kBicubicLog;
+   fMode = mode;
+   fTaxis = &taxis;
+   fEaxis = eaxis;
+   fValues = values;
+   fLogT = logValue && taxis.Centers()[0]>0;
+   fLogE = logValue && eaxis && eaxis->Centers()[0]>0;
+   fT.resize(nt);
+   for (size_t i=0; i<nt; i++)
+      fT[i] = fLogT ? log(taxis.Centers()[i]) : taxis.Centers()[i];
+   fE.resize(ne, 0.);
+   for (size_t i=0; eaxis && i<ne; i++)
+      fE[i] = fLogE ? log(eaxis->Centers()[i]) : eaxis->Centers()[i];
+   fInvT.resize(nt, 0.);
+   for (size_t i=0; i+1<nt; i++) fInvT[i] = 1/(fT[i+1]-fT[i]);
+   fInvE.resize(ne, 0.);
+   for (size_t i=0; i+1<ne; i++) fInvE[i] = 1/(fE[i+1]-fE[i]);
+
+   // -inf marks values that are not positive in log modes
+   vector<double> y(nt*ne);
+   for (size_t i=0; i<nt*ne; i++)
+      y[i] = !logValue ? values[i] : values[i]>0 ? log(values[i]) : -HUGE_VAL;
+
+   // derivatives along time, along energy and the cross one at centers
+   vector<double> dt(nt*ne, 0.), de(nt*ne, 0.), dte(nt*ne, 0.);
+   if (cubic) {
+      const bool monotone = mode==kMonotoneCubic;
+      for (size_t ie=0; ie<ne; ie++)
+         Slopes(nt, &fT[0], &y[ie], &y[ie], ne, monotone, &dt[ie]);
+      for (size_t it=0; eaxis && it<nt; it++)
+         Slopes(ne, &fE[0], &y[it*ne], &y[it*ne], 1, monotone, &de[it*ne]);
+      // no twist keeps monotone cubics monotone along both axes
+      for (size_t ie=0; !monotone && eaxis && ie<ne; ie++)
+         Slopes(nt, &fT[0], &de[ie], &y[ie], ne, false, &dte[ie]);
+   }
+
+   // polynomials of cells in between neighbouring centers
+   fNs = cubic ? 4 : 2;
+   fNr = eaxis ? fNs : 1;
+   const size_t ncells = (nt-1)*(eaxis ? ne-1 : 1), size = fNs*fNr;
+   fCoefficients.assign(ncells*size, 0.);
+   for (size_t it=0; it+1<nt; it++) {
+      for (size_t ie=0; ie<(eaxis ? ne-1 : 1); ie++) {
+         double *a = &fCoefficients[(it*(eaxis ? ne-1 : 1)+ie)*size];
+         // corners (s, r): index of s, then of r
+         const size_t de1 = eaxis ? 1 : 0;
+         const size_t corner[2][2] = {{it*ne+ie, it*ne+ie+de1},
+            {(it+1)*ne+ie, (it+1)*ne+ie+de1}};
+         bool valid = true;
+         for (int i=0; i<2; i++)
+            for (int j=0; j<2; j++)
+               valid = valid && isfinite(y[corner[i][j]]);
+         if (!valid) { a[0] = NAN; continue; }
+
+         if (!cubic) {
+            const double f00 = y[corner[0][0]], f10 = y[corner[1][0]];
+            if (!eaxis) { a[0] = f00; a[1] = f10-f00; continue; }
+            const double f01 = y[corner[0][1]], f11 = y[corner[1][1]];
+            a[0] = f00; a[1] = f01-f00; a[2] = f10-f00;
+            a[3] = f11-f10-f01+f00;
+            continue;
+         }
+
+         // values and derivatives scaled to the cell, see kHermite
+         const double ht = fT[it+1]-fT[it], he = eaxis ? fE[ie+1]-fE[ie] : 0;
+         double f[4][4] = {{0}};
+         for (int i=0; i<2; i++)
+            for (int j=0; j<(eaxis ? 2 : 1); j++) {
+               size_t c = corner[i][j];
+               f[i][j] = y[c];
+               f[2+i][j] = dt[c]*ht;
+               f[i][2+j] = de[c]*he;
+               f[2+i][2+j] = dte[c]*ht*he;
+            }
+         if (!eaxis) {
+            for (int i=0; i<4; i++)
+               for (int k=0; k<4; k++) a[i] += kHermite[i][k]*f[k][0];
+            continue;
+         }
+         double g[4][4] = {{0}}; // kHermite*f
+         for (int i=0; i<4; i++)
+            for (int j=0; j<4; j++)
+               for (int k=0; k<4; k++) g[i][j] += kHermite[i][k]*f[k][j];
+         for (int i=0; i<4; i++)
+            for (int j=0; j<4; j++)
+               for (int k=0; k<4; k++) a[i*4+j] += g[i][k]*kHermite[j][k];
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::Interpolator::Locate(const GridAxis &axis, bool isLog,
+      const vector<double> &x, const vector<double> &inv, double position,
+      int &i, double &w)
+{
+   if (!axis.Locate(position, i, w)) return false;
+   if (isLog && w>0 && w<1) w = (log(position)-x[i])*inv[i];
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::Interpolator::Evaluate(double time, double energy) const
+{
+   if (fMode==kLinear) return 0;
+   int it, ie=0;
+   double s, r=0;
+   if (!Locate(*fTaxis, fLogT, fT, fInvT, time, it, s)) return 0;
+   if (fEaxis && !Locate(*fEaxis, fLogE, fE, fInvE, energy, ie, r)) return 0;
+
+   const size_t ne = fEaxis ? fEaxis->GetNbins() : 1;
+   const double *a = &fCoefficients[(it*(fEaxis ? ne-1 : 1)+ie)*fNs*fNr];
+   if (a[0]!=a[0]) {
+      // linear in values for cells with values that are not positive
+      if (!fValues) return NAN;
+      fTaxis->Locate(time, it, s);
+      const double *v = fValues + it*ne;
+      if (!fEaxis) return (1-s)*v[0] + s*v[1];
+      fEaxis->Locate(energy, ie, r);
+      v += ie;
+      return (1-s)*((1-r)*v[0] + r*v[1]) + s*((1-r)*v[ne] + r*v[ne+1]);
+   }
+
+   double value;
+   if (fNs==2)
+      value = fEaxis ? Polynomial<2,2>(a, s, r) : Polynomial<2,1>(a, s, r);
+   else value = fEaxis ? Polynomial<4,4>(a, s, r) : Polynomial<4,1>(a, s, r);
+   return fMode==kMonotoneCubic ? value : exp(value);
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,81 @@
+#ifndef INTERPOLATOR_H
+#define INTERPOLATOR_H
+
+#include <vector>
+
+namespace NEUS { class Interpolator; class GridAxis; }
+
+/**
+ * Higher-order interpolation of values given at bin centers.
+ * Values are given on one axis, or on a time and an energy axis, laid out
+ * as in SpectrumGrid::Content(). The polynomial of each cell in between
+ * neighbouring centers is computed once in Set(), so that an evaluation is
+ * a bin search followed by a few FMAs (3 for bilinear, 15 for bicubic).
+ *
+ * Modes:
+ * kLinear: linear in values and coordinates, as TH1/TH2::Interpolate. No
+ *          table is made; SpectrumGrid and SpectrumSummary keep doing it
+ *          themselves.
+ * kLogLog: linear in log(value) and log(coordinate), for spectra falling
+ *          as power laws or exponentials over decades.
+ * kMonotoneCubic: cubic Hermite in values with Fritsch-Carlson slopes, so
+ *          that no overshoot appears in between monotone values.
+ * kBicubicLog: cubic Hermite in log(value) and log(coordinate) with slopes
+ *          from three-point differences.
+ *
+ * Logarithms of a coordinate are only taken if all bin centers of its axis
+ * are positive. Cells with a value that is not positive fall back to
+ * kLinear in log modes. Outside of the outermost centers the value of the
+ * outermost bin is used, as in kLinear.
+ * This class does not depend on ROOT.
+ */
+class NEUS::Interpolator
+{
+   public:
+      enum EMode { kLinear=0, kLogLog, kMonotoneCubic, kBicubicLog };
+
+   private:
+      EMode fMode;
+      const GridAxis *fTaxis, *fEaxis; // fEaxis is NULL on one axis
+      bool fLogT, fLogE; // whether coordinates are logarithms
+      std::vector<double> fT, fE; // coordinates of centers
+      std::vector<double> fInvT, fInvE; // 1/distance of neighbouring centers
+      const double *fValues; // for the fall-back to kLinear
+      unsigned short fNs, fNr; // polynomial orders+1 along time and energy
+      std::vector<double> fCoefficients; // fNs*fNr per cell
+
+      /**
+       * Cell i on an axis and the position w in it, from 0 to 1.
+       */
+      static bool Locate(const GridAxis &axis, bool isLog,
+            const std::vector<double> &x, const std::vector<double> &inv,
+            double position, int &i, double &w);
+
+   public:
+      Interpolator();
+
+      /**
+       * Make the table of mode for values at centers of taxis, or of taxis
+       * and eaxis if eaxis is not NULL. Axes and values are not copied
+       * and must outlive this object.
+       */
+      void Set(EMode mode, const GridAxis &taxis, const GridAxis *eaxis,
+            const double *values);
+      void Clear();
+      EMode Mode() const { return fMode; }
+      /**
+       * Forget the values given to Set(). Cells falling back to kLinear
+       * then evaluate to NaN, for owners that interpolate them linearly
+       * themselves, e.g. SpectrumGrid, whose contents may be converted
+       * after the table is made.
+       */
+      void ReleaseValues() { fValues = 0; }
+
+      /**
+       * Value at time and energy, 0 outside of the axes.
+       * energy is ignored on one axis.
+       */
+      double Evaluate(double time, double energy=0) const;
+};
+
+#endif
@@ -1,20 +1,29 @@
 #include "LivermoreModel.h"
+#include "SpectrumGrid.h"
+#include "SpectrumSummary.h"
+#include "GridFile.h"
+#include "ThreadPool.h"
+#include "GridBuilder.h"
 
 extern "C" {
    void wilson_nl_(Double_t*, Double_t*, Double_t*, Double_t*, Double_t*);
 }
 
-#include <TH2D.h>
 #include <TSystem.h>
 
 #include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
 using namespace std;
 
 //______________________________________________________________________________
 //
 
 NEUS::LivermoreModel::LivermoreModel(const char *name, const char *title) :
-   SupernovaModel(name, title)
+   SupernovaModel(name, title), fTolerance(0), fError(0), fNcalls(0),
+   fNthreads(1)
 {
    fMinE= 2.5; // determined by wilson_NL_
    fMaxE=82.5; // no need to go higher
@@ -27,15 +36,51 @@ NEUS::LivermoreModel::LivermoreModel(const char *name, const char *title) :
 
 void NEUS::LivermoreModel::LoadData(const char *dir)
 {
+   Load(dir, kTRUE);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::LivermoreModel::FillData(const char *dir)
+{
+   Load(dir, kFALSE);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::LivermoreModel::Load(const char *dir, Bool_t cached)
+{
+   NEUS_PROFILE_SCOPE(fProfiler, kLoadData, 1);
    SupernovaModel::LoadData(dir);
    gSystem->Setenv("TOTAL_DATA_DIR", dir);
 
-   Double_t binEdgesx[400]={0};
-   Double_t binEdgesy[400]={0};
+   // The adaptive binning is only known after it is built, so a cached one
+   // is identified by the checksum, which includes the tolerance.
+   vector<Double_t> binEdgesx, binEdgesy;
+   if (fTolerance<=0) MakeFixedBins(binEdgesx, binEdgesy);
+
+   // Histograms are created from the grid when they are requested.
+   ULong64_t checksum = DataChecksum(dir, fTolerance);
+   fNcalls = 0;
+   if (!cached || !LoadCache(binEdgesx, binEdgesy, checksum)) {
+      fCore.SetGrid(new SpectrumGrid);
+      if (fTolerance>0) FillAdaptiveGrid();
+      else FillFixedGrid(binEdgesx, binEdgesy);
+      SaveCache(checksum);
+   }
+   Finalize();
+}
 
+//______________________________________________________________________________
+//
+
+void NEUS::LivermoreModel::MakeFixedBins(vector<Double_t> &binEdgesx,
+      vector<Double_t> &binEdgesy)
+{
    Double_t t=fMinT, dt;
-   UShort_t nbinsx=0;
-   binEdgesx[nbinsx] = fMinT;
+   binEdgesx.assign(1, fMinT);
    while (t<fMaxT) {
       if (t<0.1) dt = 1e-3;
       else if (t<0.5) dt = 5e-3;
@@ -44,141 +89,255 @@ void NEUS::LivermoreModel::LoadData(const char *dir)
       else if (t<10.) dt = 1e-1;
       else dt = 0.5;
 
-      nbinsx++;
-      binEdgesx[nbinsx] = binEdgesx[nbinsx-1] + dt;
+      binEdgesx.push_back(binEdgesx.back() + dt);
       t+=dt;
    }
-   binEdgesx[nbinsx] = fMaxT;
+   binEdgesx.back() = fMaxT;
 
    Double_t e=fMinE, de;
-   UShort_t nbinsy=0;
-   binEdgesy[nbinsy] = fMinE;
+   binEdgesy.assign(1, fMinE);
    while (e<fMaxE) {
       if (e<10.) de = 0.5;
       else if (e<40.) de = 1.0;
       else de = 2.0;
 
-      nbinsy++;
-      binEdgesy[nbinsy] = binEdgesy[nbinsy-1] + de;
+      binEdgesy.push_back(binEdgesy.back() + de);
       e+=de;
    }
-   binEdgesy[nbinsy] = fMaxE;
+   binEdgesy.back() = fMaxE;
+}
 
-   // create histograms
-   for (UShort_t i=1; i<=3; i++) {
-      fHN2[i] = new TH2D(Form("hN2%s%d", GetName(), i),
-            ";time [second];energy [MeV];",
-            nbinsx,binEdgesx,nbinsy,binEdgesy);
+//______________________________________________________________________________
+//
 
-      fHL2[i] = new TH2D(Form("hL2%s%d", GetName(), i),
-            ";time [second];energy [MeV];",
-            nbinsx,binEdgesx,nbinsy,binEdgesy);
-   }
-   for (UShort_t i=4; i<=6; i++) {
-      fHN2[i]=fHN2[3];
-      fHL2[i]=fHL2[3];
+void NEUS::LivermoreModel::Evaluate(size_t n, const Double_t *t,
+      const Double_t *e, Double_t *dNL) const
+{
+   if (n==0) return;
+   NEUS_PROFILE_SCOPE(fProfiler, kFill, n);
+   auto call = [t, e, dNL](size_t i) {
+      Double_t time = t[i], energy = e[i];
+      wilson_nl_(&time, &energy, &dNL[3*i], &dNL[3*i+1], &dNL[3*i+2]);
+   };
+
+   // Totani's code is not known to be reentrant, see SetNthreads()
+   if (fNthreads==1) {
+      for (size_t i=0; i<n; i++) call(i);
+      return;
    }
 
-   // fill spectra
-   Double_t dNL1, dNL2, dNL3;
-   for (UShort_t ix=1; ix<=nbinsx; ix++) {
-      for (UShort_t iy=1; iy<=nbinsy; iy++) {
-         t = fHN2[1]->GetXaxis()->GetBinLowEdge(ix);
-         e = fHN2[1]->GetYaxis()->GetBinLowEdge(iy);
-         wilson_nl_(&t, &e, &dNL1, &dNL2, &dNL3);
-
-         fHN2[1]->SetBinContent(ix,iy,dNL1/1e50);
-         fHN2[2]->SetBinContent(ix,iy,dNL2/1e50);
-         fHN2[3]->SetBinContent(ix,iy,dNL3/1e50);
-
-         fHL2[1]->SetBinContent(ix,iy,dNL1*e*1.60217646e-6/1e50);
-         fHL2[2]->SetBinContent(ix,iy,dNL2*e*1.60217646e-6/1e50);
-         fHL2[3]->SetBinContent(ix,iy,dNL3*e*1.60217646e-6/1e50);
-      }
+   // The first call reads the data files of Totani's code. The following
+   // ones run concurrently, one task per time row, i.e. per run of points
+   // at the same time.
+   call(0);
+   ThreadPool pool(fNthreads);
+   for (size_t first=1, last; first<n; first=last) {
+      for (last=first+1; last<n && t[last]==t[first]; last++) {}
+      pool.Submit([&call, first, last] {
+            for (size_t i=first; i<last; i++) call(i);
+            });
    }
+   pool.Wait();
+}
 
-   // set properties
-   fHN2[1]->GetZaxis()->SetTitle("number of #nu_{e} [10^{50}/s/MeV]");
-   fHN2[2]->GetZaxis()->SetTitle("number of #bar{#nu}_{e} [10^{50}/s/MeV]");
-   fHN2[3]->GetZaxis()->SetTitle("number of #nu_{x} [10^{50}/s/MeV]");
+//______________________________________________________________________________
+//
 
-   fHL2[1]->GetZaxis()->SetTitle("luminosity of #nu_{e} [10^{50} erg/s/MeV]");
-   fHL2[2]->GetZaxis()->SetTitle("luminosity of #bar{#nu}_{e} [10^{50} erg/s/MeV]");
-   fHL2[3]->GetZaxis()->SetTitle("luminosity of #nu_{x} [10^{50} erg/s/MeV]");
+void NEUS::LivermoreModel::DeriveLuminosity(SpectrumGrid &grid) const
+{
+   const GridAxis &axis = grid.EnergyAxis();
+   // spectra are evaluated where the grid of fTolerance says
+   const Double_t *energy = fTolerance>0 ? axis.Centers() : axis.Edges();
+   vector<Double_t> weights(axis.GetNbins());
+   for (UShort_t i=0; i<axis.GetNbins(); i++)
+      weights[i] = energy[i]*1.60217646e-6;
+   grid.DeriveLuminosity(&weights[0]);
+}
 
-   fHN2[1]->GetZaxis()->SetTitleOffset(-0.5);
-   fHN2[2]->GetZaxis()->SetTitleOffset(-0.5);
-   fHN2[3]->GetZaxis()->SetTitleOffset(-0.5);
+//______________________________________________________________________________
+//
 
-   fHL2[1]->GetZaxis()->SetTitleOffset(-0.5);
-   fHL2[2]->GetZaxis()->SetTitleOffset(-0.5);
-   fHL2[3]->GetZaxis()->SetTitleOffset(-0.5);
+void NEUS::LivermoreModel::FillFixedGrid(const vector<Double_t> &binEdgesx,
+      const vector<Double_t> &binEdgesy)
+{
+   const UShort_t nbinsx = binEdgesx.size()-1, nbinsy = binEdgesy.size()-1;
+   SpectrumGrid *grid = fCore.Grid();
+   grid->Create(nbinsx, &binEdgesx[0], nbinsy, &binEdgesy[0]);
+   DeriveLuminosity(*grid);
+   fError = 0;
+
+   // spectra at the low edges of bins
+   vector<Double_t> t, e, dNL(3*nbinsx*nbinsy);
+   for (UShort_t ix=0; ix<nbinsx; ix++) {
+      for (UShort_t iy=0; iy<nbinsy; iy++) {
+         t.push_back(binEdgesx[ix]);
+         e.push_back(binEdgesy[iy]);
+      }
+   }
+   Evaluate(t.size(), &t[0], &e[0], &dNL[0]);
+   fNcalls = t.size();
 
-   fHN2[1]->GetZaxis()->CenterTitle();
-   fHN2[2]->GetZaxis()->CenterTitle();
-   fHN2[3]->GetZaxis()->CenterTitle();
+   for (UShort_t flavor=0; flavor<3; flavor++) {
+      Double_t *n = grid->Content(SpectrumGrid::kNumber, flavor);
+      for (size_t i=0; i<t.size(); i++) n[i] = dNL[3*i+flavor]/1e50;
+   }
+}
 
-   fHL2[1]->GetZaxis()->CenterTitle();
-   fHL2[2]->GetZaxis()->CenterTitle();
-   fHL2[3]->GetZaxis()->CenterTitle();
+//______________________________________________________________________________
+//
 
-   fHN2[1]->SetTitle(GetTitle());
-   fHN2[2]->SetTitle(GetTitle());
-   fHN2[3]->SetTitle(GetTitle());
+void NEUS::LivermoreModel::FillAdaptiveGrid()
+{
+   GridBuilder builder([this](size_t n, const Double_t *t, const Double_t *e,
+            Double_t *dNL) { Evaluate(n, t, e, dNL); }, 3);
+   if (!builder.Build(fMinT, fMaxT, fMinE, fMaxE, fTolerance))
+      Warning("FillAdaptiveGrid", "Tolerance %g is not met, error: %g",
+            fTolerance, builder.Error());
+   fError = builder.Error();
+   fNcalls = builder.GetNcalls();
+
+   // spectra at the centers of bins
+   const UShort_t nbinsx = builder.TBins(), nbinsy = builder.EBins();
+   SpectrumGrid *grid = fCore.Grid();
+   grid->Create(nbinsx, &builder.TimeEdges()[0],
+         nbinsy, &builder.EnergyEdges()[0]);
+   DeriveLuminosity(*grid);
+   const Double_t *dNL = &builder.Values()[0];
+   for (UShort_t flavor=0; flavor<3; flavor++) {
+      Double_t *n = grid->Content(SpectrumGrid::kNumber, flavor);
+      for (size_t i=0; i<size_t(nbinsx)*nbinsy; i++)
+         n[i] = dNL[flavor*nbinsx*nbinsy+i]/1e50;
+   }
+}
 
-   fHL2[1]->SetTitle(GetTitle());
-   fHL2[2]->SetTitle(GetTitle());
-   fHL2[3]->SetTitle(GetTitle());
+//______________________________________________________________________________
+//
+
+Bool_t NEUS::LivermoreModel::LoadCache(const vector<Double_t> &binEdgesx,
+      const vector<Double_t> &binEdgesy, ULong64_t checksum)
+{
+   TString name = CacheFile();
+   GridFile file;
+   if (!file.Open(name)) {
+      // a missing file is not an error, it is created by SaveCache()
+      if (!gSystem->AccessPathName(name))
+         Warning("LoadCache", "%s", file.Error());
+      return kFALSE;
+   }
+   // rebuild if the binning or the data of Totani's code have changed
+   if (!file.HasGrid() || file.Checksum()!=checksum) return kFALSE;
+   if (!binEdgesx.empty() && (file.TBins()+1u!=binEdgesx.size()
+            || file.EBins()+1u!=binEdgesy.size()
+            || !equal(binEdgesx.begin(), binEdgesx.end(), file.TimeEdges())
+            || !equal(binEdgesy.begin(), binEdgesy.end(), file.EnergyEdges())))
+      return kFALSE;
+
+   SpectrumGrid *grid = new SpectrumGrid;
+   file.MapGrid(*grid);
+   DeriveLuminosity(*grid); // pages of the saved L are never read
+   fCore.SetGrid(grid);
+   fError = file.InterpolationError();
+   return kTRUE;
+}
 
-   fHN2[1]->SetStats(0);
-   fHN2[2]->SetStats(0);
-   fHN2[3]->SetStats(0);
+//______________________________________________________________________________
+//
 
-   fHL2[1]->SetStats(0);
-   fHL2[2]->SetStats(0);
-   fHL2[3]->SetStats(0);
+Bool_t NEUS::LivermoreModel::SaveCache(ULong64_t checksum)
+{
+   TString name = CacheFile();
+   gSystem->mkdir(gSystem->DirName(name), kTRUE);
+   string error = GridFile::Write(name, fCore.Grid(), 0, 0, 0, checksum,
+         fError);
+   if (!error.empty()) {
+      Warning("SaveCache", "%s", error.c_str());
+      return kFALSE;
+   }
+   return kTRUE;
+}
 
-   fHN2[1]->SetLineColor(kBlack);
-   fHN2[2]->SetLineColor(kRed);
-   fHN2[3]->SetLineColor(kBlue);
+//______________________________________________________________________________
+//
 
-   fHL2[1]->SetLineColor(kBlack);
-   fHL2[2]->SetLineColor(kRed);
-   fHL2[3]->SetLineColor(kBlue);
+const char* NEUS::LivermoreModel::CacheFile()
+{
+   return Form("%s/bindata/livermore.bin", fDataLocation.Data());
 }
 
 //______________________________________________________________________________
 //
 
-void NEUS::LivermoreModel::UseDivariData()
+ULong64_t NEUS::LivermoreModel::DataChecksum(const char *dir,
+      Double_t tolerance)
 {
-   fTotalN[1] = 3.0e7; // * 1e50
-   fTotalN[2] = 2.1e7; // * 1e50
-   fTotalN[3] = 1.85e7; // * 1e50
+   // names of regular files directly in dir, in a fixed order
+   vector<string> names;
+   void *directory = gSystem->OpenDirectory(dir);
+   if (directory) {
+      while (const char *entry = gSystem->GetDirEntry(directory)) {
+         FileStat_t status;
+         if (gSystem->GetPathInfo(Form("%s/%s", dir, entry), status)==0
+               && R_ISREG(status.fMode)) names.push_back(entry);
+      }
+      gSystem->FreeDirectory(directory);
+   }
+   sort(names.begin(), names.end());
+
+   // 64-bit FNV-1a of names and contents
+   ULong64_t hash = 14695981039346656037ULL;
+   auto add = [&hash](const char *data, size_t length) {
+      for (size_t i=0; i<length; i++) {
+         hash ^= static_cast<unsigned char>(data[i]);
+         hash *= 1099511628211ULL;
+      }
+   };
+   vector<char> buffer(1<<16);
+   for (size_t i=0; i<names.size(); i++) {
+      add(names[i].c_str(), names[i].size()+1);
+      ifstream file(Form("%s/%s", dir, names[i].c_str()), ios::binary);
+      while (file.read(&buffer[0], buffer.size()) || file.gcount()>0)
+         add(&buffer[0], file.gcount());
+   }
+   if (tolerance>0)
+      add(reinterpret_cast<const char*>(&tolerance), sizeof(tolerance));
+   return hash;
+}
 
-   fAverageE[1] = 3.5*3; // MeV
-   fAverageE[2] = 5.0*3; // MeV
-   fAverageE[3] = 8.0*3; // MeV
+//______________________________________________________________________________
+//
 
+void NEUS::LivermoreModel::UseDivariData()
+{
    SetName("DivariApproximation");
    SetTitle("Divari approximation");
+   Finalize();
 }
 
 //______________________________________________________________________________
 //
 
-void NEUS::LivermoreModel::Clear(Option_t *option)
+void NEUS::LivermoreModel::Summarize(SpectrumSummary &summary)
 {
-   fTotalN[1] = 0.;
-   fTotalN[2] = 0.;
-   fTotalN[3] = 0.;
+   SupernovaModel::Summarize(summary);
+   if (fName!="DivariApproximation") return;
 
-   fAverageE[1] = 1.;
-   fAverageE[2] = 1.;
-   fAverageE[3] = 1.;
+   summary.SetTotalN(0, 3.0e7); // * 1e50
+   summary.SetTotalN(1, 2.1e7); // * 1e50
+   summary.SetTotalN(2, 1.85e7); // * 1e50
 
+   summary.SetAverageE(0, 3.5*3); // MeV
+   summary.SetAverageE(1, 5.0*3); // MeV
+   summary.SetAverageE(2, 8.0*3); // MeV
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::LivermoreModel::Clear(Option_t *option)
+{
    SetName("LivermoreModel");
    SetTitle("Livermore model");
+   Finalize(); // drop totals set by UseDivariData()
 }
 
 //______________________________________________________________________________
@@ -3,32 +3,142 @@
 
 #include "SupernovaModel.h"
 
+#include <vector>
+
 namespace NEUS { class LivermoreModel; }
 
 /**
  * Livermore model.
- * Totani's interpolator written in Fortran is used to fill histograms, which
- * are used for visualization and fast interpolation.
+ * Totani's interpolator written in Fortran is used to fill a grid, which is
+ * used for fast interpolation and to create histograms for visualization.
+ *
+ * By default the grid has fixed bins, 1 ms wide at the beginning and up to
+ * 0.5 s wide at the end, filled with spectra at their low edges. With
+ * SetTolerance(), bins are instead cut only where the spectra change fast,
+ * until interpolation meets a relative tolerance, and filled with spectra
+ * at their centers, see GridBuilder. InterpolationError() then tells the
+ * error achieved.
+ *
+ * L(t, E) is N(t, E) times the energy at which it is evaluated, so it is
+ * not kept in the grid but computed from N(t, E) where it is used, see
+ * SpectrumGrid::DeriveLuminosity().
+ *
+ * Filling the grid takes one Fortran call per bin. The filled grid is
+ * therefore saved to CacheFile() together with a checksum of the data files
+ * of Totani's code, and later loads map that file instead, as long as the
+ * binning and the checksum are the same.
  */
 class NEUS::LivermoreModel : public SupernovaModel
 {
+   private:
+      Double_t fTolerance; //! of the adaptive binning, 0 for fixed bins
+      Double_t fError; //! achieved by the adaptive binning
+      ULong64_t fNcalls; //! of Totani's code by the last fill
+      UInt_t fNthreads; //! threads filling the grid, see SetNthreads()
+
+      void MakeFixedBins(std::vector<Double_t> &binEdgesx,
+            std::vector<Double_t> &binEdgesy);
+      /**
+       * Spectra of v_e, anti-v_e and v_x from Totani's interpolator at n
+       * points (t[i], e[i]), saved in dNL[3*i], dNL[3*i+1] and dNL[3*i+2].
+       * Points are evaluated one after another, or by time rows in
+       * parallel if SetNthreads() allows it.
+       */
+      void Evaluate(size_t n, const Double_t *t, const Double_t *e,
+            Double_t *dNL) const;
+      /**
+       * Compute L of grid from N, at the low edges of energy bins for
+       * fixed bins, at their centers for adaptive ones.
+       */
+      void DeriveLuminosity(SpectrumGrid &grid) const;
+      void FillFixedGrid(const std::vector<Double_t> &binEdgesx,
+            const std::vector<Double_t> &binEdgesy);
+      void FillAdaptiveGrid();
+      /**
+       * Map CacheFile() to the grid if it has the given checksum and binning.
+       * Any binning is accepted if the bin edges are empty.
+       */
+      Bool_t LoadCache(const std::vector<Double_t> &binEdgesx,
+            const std::vector<Double_t> &binEdgesy, ULong64_t checksum);
+      Bool_t SaveCache(ULong64_t checksum);
+      /**
+       * Map the grid from CacheFile() if cached is kTRUE and the cache is
+       * up to date, otherwise fill it and save it there.
+       */
+      void Load(const char *dir, Bool_t cached);
+      /**
+       * Checksum of the names and contents of the files in dir, and of the
+       * tolerance of an adaptive binning.
+       * Sub-directories, such as the one of CacheFile(), are not included.
+       */
+      static ULong64_t DataChecksum(const char *dir, Double_t tolerance);
+
+   protected:
+      /**
+       * Replace totals by those of Divari 2012 after UseDivariData().
+       */
+      void Summarize(SpectrumSummary &summary);
+
    public:
       LivermoreModel(const char *name="LivermoreModel",
             const char *title="Livermore model");
       ~LivermoreModel() {};
 
+      /**
+       * Load data from dir, the data directory of Totani's code.
+       * The grid is mapped from CacheFile() if it is up to date, otherwise
+       * it is filled and saved there.
+       */
       void LoadData(const char *dir);
+      /**
+       * Fill the grid with Totani's code and save it to CacheFile() even
+       * if the cache is up to date.
+       */
+      void FillData(const char *dir);
+      /**
+       * dir/bindata/livermore.bin, where dir is given to LoadData().
+       */
+      const char* CacheFile();
+      /**
+       * Number of threads used to fill the grid when the cache is rebuilt.
+       * 1, the default, fills it serially: Totani's Fortran is not known to
+       * be reentrant and may keep state in SAVE or COMMON variables between
+       * calls. More threads, or 0 for one per hardware thread, evaluate
+       * time rows in parallel after one serial call, which is only safe
+       * once that code is audited. bench/models.C compares grids filled by
+       * 1 and 8 threads, which a data race may still pass.
+       */
+      void SetNthreads(UInt_t nthreads) { fNthreads=nthreads; }
+      /**
+       * Relative error of N(t, E) and L(t, E) interpolated in between bin
+       * centers allowed in the grid filled by the next LoadData().
+       * Values below 1e-3 of the maximum count as 1e-3 of the maximum.
+       * 0, the default, means the fixed bins.
+       */
+      void SetTolerance(Double_t tolerance) { fTolerance=tolerance; }
+      Double_t GetTolerance() const { return fTolerance; }
+      /**
+       * Largest relative error of interpolation found in the middle of
+       * cells in the adaptive grid, 0 for the fixed bins, which are not
+       * checked.
+       */
+      Double_t InterpolationError() const { return fError; }
+      /**
+       * Calls of Totani's interpolator made by the last fill of the grid,
+       * 0 if it was loaded from CacheFile().
+       */
+      ULong64_t GetNcalls() const { return fNcalls; }
       /**
        * Use <E> and N given in Divari 2012.
        * Divari et al. claim that they use the Livermore model for their
        * calculation in http://stacks.iop.org/0954-3899/39/i=9/a=095204. But
        * the average energy and total number of neutrinos used in their paper
        * are different from Totani's Fortran code. This function is used to set
-       * <E> and N to the values in their paper.
+       * <E> and N to the values in their paper. Ne() then returns NeFD().
        */
       void UseDivariData();
       /**
-       * Clear internal data.
+       * Undo UseDivariData().
        */
       void Clear(Option_t *option="");
 
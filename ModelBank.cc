@@ -0,0 +1,143 @@
+#include "ModelBank.h"
+#include "ThreadPool.h"
+#include "NakazatoModel.h"
+#include "LivermoreModel.h"
+
+#include <TH1.h>
+#include <TROOT.h>
+
+#include <cstring>
+using namespace std;
+
+//______________________________________________________________________________
+//
+
+NEUS::ModelBank::ModelBank(const char *nakazatoDir, const char *livermoreDir) :
+   fNakazatoDir(nakazatoDir), fLivermoreDir(livermoreDir), fModels(),
+   fIsLivermore(), fStorage(SpectrumGrid::kDouble) {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ModelBank::Clear()
+{
+   for (UInt_t i=0; i<fModels.size(); i++) delete fModels[i];
+   fModels.clear();
+   fIsLivermore.clear();
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::NakazatoModel* NEUS::ModelBank::AddNakazato(
+      Float_t initialMass, Float_t metallicity, Float_t reviveTime)
+{
+   NakazatoModel *model = new NakazatoModel(initialMass,metallicity,reviveTime);
+   fModels.push_back(model);
+   fIsLivermore.push_back(false);
+   return model;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ModelBank::AddAllNakazato()
+{
+   const UShort_t nm = 21;
+   Float_t mass[nm] = {13,13,13,13,13,13, 20,20,20,20,20,20,
+      30,30,30, 50,50,50,50,50,50};
+   Float_t meta[nm] = {0.02,0.02,0.02,0.004,0.004,0.004,
+      0.02,0.02,0.02,0.004,0.004,0.004, 0.02,0.02,0.02,
+      0.02,0.02,0.02,0.004,0.004,0.004};
+   Float_t trev[nm] = {100,200,300,100,200,300, 100,200,300,100,200,300,
+   100,200,300, 100,200,300,100,200,300};
+
+   for (UShort_t i=0; i<nm; i++) AddNakazato(mass[i],meta[i],trev[i]);
+   AddNakazato(30,0.004); // black hole
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::LivermoreModel* NEUS::ModelBank::AddLivermore(
+      const char *name, const char *title)
+{
+   LivermoreModel *model = new LivermoreModel(name, title);
+   fModels.push_back(model);
+   fIsLivermore.push_back(true);
+   return model;
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::SupernovaModel* NEUS::ModelBank::Get(const char *name) const
+{
+   for (UInt_t i=0; i<fModels.size(); i++)
+      if (strcmp(fModels[i]->GetName(), name)==0) return fModels[i];
+   return 0;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ModelBank::Derive(ThreadPool &pool, SupernovaModel *model)
+{
+   // totals are computed by LoadData(), the rest needs N(t, E)
+   if (!model->HasSpectrum()) return;
+
+   // histograms of all flavors are created together from the grid,
+   // which must not be done concurrently by tasks of different flavors
+   if (fStorage==SpectrumGrid::kDouble) {
+      model->HN2(1);
+      model->HL2(1);
+   }
+
+   // types 4, 5 and 6 share data with type 3
+   for (UShort_t type=1; type<=3; type++) {
+      pool.Submit([model, type] {
+            model->HNe(type);
+            model->HNt(type);
+            model->HLt(type);
+            model->HEt(type);
+            });
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ModelBank::Load(UInt_t nthreads, Bool_t derive)
+{
+   // thread-local gDirectory and Form() buffers, and no histogram is
+   // registered to a directory, which is a list shared by all threads
+   ROOT::EnableThreadSafety();
+   Bool_t addDirectory = TH1::AddDirectoryStatus();
+   TH1::AddDirectory(kFALSE);
+
+   ThreadPool pool(nthreads);
+   vector<SupernovaModel*> livermore;
+   for (UInt_t i=0; i<fModels.size(); i++) {
+      SupernovaModel *model = fModels[i];
+      model->SetStorage(fStorage);
+      if (fIsLivermore[i]) { livermore.push_back(model); continue; }
+      pool.Submit([this, &pool, model, derive] {
+            model->LoadData(fNakazatoDir);
+            if (derive) Derive(pool, model);
+            });
+   }
+   if (!livermore.empty()) {
+      pool.Submit([this, &pool, livermore, derive] {
+            for (UInt_t i=0; i<livermore.size(); i++) {
+               livermore[i]->LoadData(fLivermoreDir);
+               if (derive) Derive(pool, livermore[i]);
+            }
+            });
+   }
+   pool.Wait();
+
+   TH1::AddDirectory(addDirectory);
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,99 @@
+#ifndef MODELBANK_H
+#define MODELBANK_H
+
+#include "SpectrumGrid.h"
+
+#include <TString.h>
+
+#include <vector>
+
+namespace NEUS {
+   class ModelBank;
+   class ThreadPool;
+   class SupernovaModel;
+   class NakazatoModel;
+   class LivermoreModel;
+}
+
+/**
+ * A set of models loaded in parallel.
+ * Models are added with AddNakazato() and AddLivermore() and loaded with
+ * Load(), which runs LoadData() of all models concurrently on a
+ * work-stealing thread pool. Histograms of derived products, HNe(), HNt(),
+ * HLt() and HEt() with default cuts, are then created in parallel per model
+ * and per flavor, so that they are ready when the models are used. Each
+ * product is computed by exactly the same code as in a serial program, so
+ * the results are bit-identical.
+ *
+ * With SetStorage(), grids of the models are kept in a smaller storage,
+ * and HN2() and HL2() are no longer created by Load(), as they would keep
+ * N(t, E) and L(t, E) in double.
+ *
+ * Totani's Fortran interpolator used by LivermoreModel reads its data files
+ * in its first call and is not known to be reentrant afterwards, see
+ * LivermoreModel::SetNthreads(). Livermore models are therefore loaded one
+ * after another in a single task, which runs in parallel with the loading
+ * of Nakazato models.
+ *
+ * The bank owns its models and deletes them when it is deleted.
+ */
+class NEUS::ModelBank
+{
+   private:
+      TString fNakazatoDir; // passed to NakazatoModel::LoadData()
+      TString fLivermoreDir; // passed to LivermoreModel::LoadData()
+
+      std::vector<SupernovaModel*> fModels; // in the order they are added
+      std::vector<bool> fIsLivermore;
+      SpectrumGrid::EStorage fStorage; // of models loaded by Load()
+
+      /**
+       * Submit tasks computing derived products of a loaded model.
+       */
+      void Derive(ThreadPool &pool, SupernovaModel *model);
+
+      ModelBank(const ModelBank&);
+      ModelBank& operator=(const ModelBank&);
+
+   public:
+      ModelBank(const char *nakazatoDir=".",
+            const char *livermoreDir="../total");
+      ~ModelBank() { Clear(); }
+
+      void Clear();
+
+      NakazatoModel* AddNakazato(Float_t initialMass, Float_t metallicity,
+            Float_t reviveTime=100);
+      /**
+       * All 21 Nakazato models followed by the black hole one.
+       */
+      void AddAllNakazato();
+      LivermoreModel* AddLivermore(const char *name="LivermoreModel",
+            const char *title="Livermore model");
+
+      /**
+       * Load all models and compute their derived products.
+       * nthreads: number of threads, 0 means one per hardware thread.
+       * derive: kFALSE skips the derived products, so that N(t, E) and
+       * L(t, E) of a flavor are only read when the flavor is used, see
+       * SpectrumGrid::Defer().
+       */
+      void Load(UInt_t nthreads=0, Bool_t derive=kTRUE);
+      /**
+       * Storage of models loaded by Load() from now on, see
+       * SupernovaModel::SetStorage(). It is SpectrumGrid::kDouble by
+       * default.
+       */
+      void SetStorage(SpectrumGrid::EStorage storage) { fStorage = storage; }
+      SpectrumGrid::EStorage Storage() const { return fStorage; }
+
+      UInt_t GetN() const { return fModels.size(); }
+      SupernovaModel* At(UInt_t i) const
+      { return i<fModels.size() ? fModels[i] : 0; }
+      /**
+       * Model of the given name, NULL if it is not in the bank.
+       */
+      SupernovaModel* Get(const char *name) const;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "NakazatoFamily.h"
+#include "NakazatoModel.h"
+#include "ModelBank.h"
+
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+const Double_t NEUS::NakazatoFamily::fgMass[] = {13, 20, 30, 50};
+const Double_t NEUS::NakazatoFamily::fgMetallicity[] = {0.004, 0.02};
+const Double_t NEUS::NakazatoFamily::fgReviveTime[] = {100, 200, 300};
+
+namespace {
+   // Find i so that x is in [nodes[i], nodes[i+1]] and the weight w of
+   // nodes[i+1] in between, counting only nodes that are used. w is 0 on a
+   // node. False is returned if x is out of them.
+   bool Bracket(const Double_t *nodes, const bool *used, UShort_t n,
+         Double_t x, UShort_t &i0, UShort_t &i1, Double_t &w,
+         bool isLog=false)
+   {
+      i0 = n;
+      for (UShort_t i=0; i<n; i++) {
+         if (!used[i]) continue;
+         if (nodes[i]<=x) i0 = i;
+         else if (i0<n) {
+            i1 = i;
+            w = isLog ? log(x/nodes[i0])/log(nodes[i1]/nodes[i0])
+               : (x-nodes[i0])/(nodes[i1]-nodes[i0]);
+            return true;
+         }
+      }
+      // the last node used
+      if (i0==n || nodes[i0]!=x) return false;
+      i1 = i0;
+      w = 0;
+      return true;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::InterpolatedModel::InterpolatedModel() : fN(0), fMass(0),
+   fMetallicity(0), fReviveTime(0)
+{
+   for (UShort_t i=0; i<fgNmax; i++) {
+      fModels[i] = 0;
+      fWeights[i] = 0;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::InterpolatedModel::Add(const SupernovaModel *model,
+      Double_t weight)
+{
+   if (weight==0) return;
+   for (UShort_t i=0; i<fN; i++)
+      if (fModels[i]==model) { fWeights[i] += weight; return; }
+   fModels[fN] = model;
+   fWeights[fN] = weight;
+   fN++;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::N2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   return Sum([&](const SupernovaModel &m) {
+         return m.N2(type, time, energy); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::L2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   return Sum([&](const SupernovaModel &m) {
+         return m.L2(type, time, energy); });
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::InterpolatedModel::N2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   fill(result, result+n, 0.);
+   const size_t chunk = 256;
+   Double_t values[chunk];
+   for (size_t first=0; first<n; first+=chunk) {
+      const size_t m = min(chunk, n-first);
+      for (UShort_t i=0; i<fN; i++) {
+         fModels[i]->N2(type, time+first, energy+first, values, m);
+         for (size_t k=0; k<m; k++) result[first+k] += fWeights[i]*values[k];
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::InterpolatedModel::L2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   fill(result, result+n, 0.);
+   const size_t chunk = 256;
+   Double_t values[chunk];
+   for (size_t first=0; first<n; first+=chunk) {
+      const size_t m = min(chunk, n-first);
+      for (UShort_t i=0; i<fN; i++) {
+         fModels[i]->L2(type, time+first, energy+first, values, m);
+         for (size_t k=0; k<m; k++) result[first+k] += fWeights[i]*values[k];
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::Nt(UShort_t type, Double_t time,
+      Double_t emax) const
+{
+   return Sum([&](const SupernovaModel &m) { return m.Nt(type, time, emax); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::Ne(UShort_t type, Double_t energy,
+      Double_t tmax) const
+{
+   return Sum([&](const SupernovaModel &m) {
+         return m.Ne(type, energy, tmax); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::Nall(UShort_t type) const
+{
+   return Sum([&](const SupernovaModel &m) { return m.Nall(type); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::Lall(UShort_t type) const
+{
+   return Sum([&](const SupernovaModel &m) { return m.Lall(type); });
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::InterpolatedModel::Eave(UShort_t type) const
+{
+   Double_t n = Nall(type);
+   return n>0 ? Lall(type)/n/1.60217646e-6 : 0;
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::NakazatoFamily::NakazatoFamily(const ModelBank &bank) : fBank(0)
+{
+   Index(bank);
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::NakazatoFamily::NakazatoFamily(const char *dir, UInt_t nthreads)
+   : fBank(new ModelBank(dir))
+{
+   fBank->AddAllNakazato();
+   fBank->Load(nthreads);
+   Index(*fBank);
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::NakazatoFamily::~NakazatoFamily()
+{
+   if (fBank) delete fBank;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::NakazatoFamily::Index(const ModelBank &bank)
+{
+   for (UShort_t im=0; im<fgNmass; im++)
+      for (UShort_t iz=0; iz<fgNmetallicity; iz++)
+         for (UShort_t it=0; it<fgNrevive; it++) fModels[im][iz][it] = 0;
+
+   for (UInt_t i=0; i<bank.GetN(); i++) {
+      NakazatoModel *model = dynamic_cast<NakazatoModel*>(bank.At(i));
+      if (!model || !model->HasSpectrum()) continue; // not the black hole
+      for (UShort_t im=0; im<fgNmass; im++)
+         for (UShort_t iz=0; iz<fgNmetallicity; iz++)
+            for (UShort_t it=0; it<fgNrevive; it++)
+               if (model->InitialMass()==fgMass[im]
+                     && fabs(model->Metallicity()-fgMetallicity[iz])<1e-4
+                     && model->ReviveTime()==fgReviveTime[it])
+                  fModels[im][iz][it] = model;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::InterpolatedModel NEUS::NakazatoFamily::Interpolate(Double_t mass,
+      Double_t metallicity, Double_t reviveTime) const
+{
+   InterpolatedModel result;
+   result.fMass = mass;
+   result.fMetallicity = metallicity;
+   result.fReviveTime = reviveTime;
+
+   const bool all[fgNmass] = {true, true, true, true};
+   UShort_t z[2], t[2];
+   Double_t wz, wt;
+   if (!Bracket(fgMetallicity, all, fgNmetallicity, metallicity, z[0], z[1],
+            wz, true)) return result;
+   if (!Bracket(fgReviveTime, all, fgNrevive, reviveTime, t[0], t[1], wt))
+      return result;
+
+   InterpolatedModel sum = result;
+   for (UShort_t j=0; j<2; j++) {
+      const Double_t weightZ = j ? wz : 1-wz;
+      if (weightZ==0) continue;
+      // masses of the metallicity with models
+      bool used[fgNmass];
+      for (UShort_t im=0; im<fgNmass; im++) {
+         used[im] = false;
+         for (UShort_t it=0; it<fgNrevive; it++)
+            if (fModels[im][z[j]][it]) used[im] = true;
+      }
+      UShort_t m[2];
+      Double_t wm;
+      if (!Bracket(fgMass, used, fgNmass, mass, m[0], m[1], wm)) return result;
+      for (UShort_t k=0; k<2; k++)
+         for (UShort_t l=0; l<2; l++) {
+            const Double_t w = weightZ*(k ? wm : 1-wm)*(l ? wt : 1-wt);
+            if (w==0) continue;
+            const SupernovaModel *model = fModels[m[k]][z[j]][t[l]];
+            if (!model) return result;
+            sum.Add(model, w);
+         }
+   }
+   return sum;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,128 @@
+#ifndef NAKAZATOFAMILY_H
+#define NAKAZATOFAMILY_H
+
+#include <Rtypes.h>
+
+#include <cstddef>
+
+namespace NEUS {
+   class NakazatoFamily;
+   class InterpolatedModel;
+   class ModelBank;
+   class SupernovaModel;
+}
+
+/**
+ * Model in between Nakazato models in the space of initial mass,
+ * metallicity and revive time, made by NakazatoFamily::Interpolate().
+ * It keeps the up to 8 neighbouring models and their weights; all
+ * quantities are weighted sums of theirs, computed on the fly, so that it
+ * takes no memory for spectra of its own. It is a small value that can be
+ * copied freely, but the family it comes from must outlive it.
+ *
+ * Queries are const and can be called from many threads at the same time.
+ * An invalid model, or a type of neutrino not in 1 to 6, gives 0.
+ */
+class NEUS::InterpolatedModel
+{
+   public:
+      static const UShort_t fgNmax = 8; // neighbours
+
+   private:
+      UShort_t fN;
+      const SupernovaModel *fModels[fgNmax];
+      Double_t fWeights[fgNmax];
+      Double_t fMass, fMetallicity, fReviveTime;
+
+      friend class NakazatoFamily;
+      void Add(const SupernovaModel *model, Double_t weight);
+
+      template<typename F> Double_t Sum(F f) const
+      {
+         Double_t sum = 0;
+         for (UShort_t i=0; i<fN; i++) sum += fWeights[i]*f(*fModels[i]);
+         return sum;
+      }
+
+   public:
+      InterpolatedModel();
+
+      /**
+       * Whether the parameters are inside the family.
+       */
+      Bool_t IsValid() const { return fN>0; }
+      Double_t InitialMass() const { return fMass; }
+      Double_t Metallicity() const { return fMetallicity; }
+      Double_t ReviveTime() const { return fReviveTime; }
+
+      /**
+       * Neighbouring models and their weights, which add up to 1.
+       */
+      UShort_t GetN() const { return fN; }
+      const SupernovaModel* Neighbour(UShort_t i) const { return fModels[i]; }
+      Double_t Weight(UShort_t i) const { return fWeights[i]; }
+
+      /**
+       * Same as those of SupernovaModel.
+       */
+      Double_t N2(UShort_t type, Double_t time, Double_t energy) const;
+      Double_t L2(UShort_t type, Double_t time, Double_t energy) const;
+      void N2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, std::size_t n) const;
+      void L2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, std::size_t n) const;
+      Double_t Nt(UShort_t type, Double_t time, Double_t emax=999.) const;
+      Double_t Ne(UShort_t type, Double_t energy, Double_t tmax=999.) const;
+      Double_t Nall(UShort_t type) const;
+      Double_t Lall(UShort_t type) const;
+      Double_t Eave(UShort_t type) const;
+};
+
+/**
+ * Loaded Nakazato models seen as a function of initial mass, metallicity
+ * and revive time. Interpolate() gives a model at any point in between
+ * them, multilinear in mass, log(metallicity) and revive time. With
+ * metallicity 0.004, there is no 30 Solar mass supernova, so that masses
+ * in between 20 and 50 Solar masses are interpolated between those two.
+ * The black hole model is not used.
+ */
+class NEUS::NakazatoFamily
+{
+   public:
+      static const UShort_t fgNmass = 4, fgNmetallicity = 2, fgNrevive = 3;
+      static const Double_t fgMass[fgNmass]; // Solar mass
+      static const Double_t fgMetallicity[fgNmetallicity];
+      static const Double_t fgReviveTime[fgNrevive]; // ms
+
+   private:
+      ModelBank *fBank; // owned if the family loads the models itself
+      const SupernovaModel *fModels[fgNmass][fgNmetallicity][fgNrevive];
+
+      void Index(const ModelBank &bank);
+
+      NakazatoFamily(const NakazatoFamily&);
+      NakazatoFamily& operator=(const NakazatoFamily&);
+
+   public:
+      /**
+       * Use the loaded Nakazato models in bank, which must outlive the
+       * family.
+       */
+      explicit NakazatoFamily(const ModelBank &bank);
+      /**
+       * Load all Nakazato models from dir with nthreads threads, see
+       * ModelBank::Load().
+       */
+      explicit NakazatoFamily(const char *dir, UInt_t nthreads=0);
+      ~NakazatoFamily();
+
+      /**
+       * Model at the given initial mass in Solar mass, metallicity and
+       * revive time in ms. It is invalid outside of [13, 50] x
+       * [0.004, 0.02] x [100, 300] or if a neighbour is not loaded.
+       */
+      InterpolatedModel Interpolate(Double_t mass, Double_t metallicity,
+            Double_t reviveTime) const;
+};
+
+#endif
@@ -1,12 +1,25 @@
 #include "NakazatoModel.h"
+#include "SpectrumGrid.h"
+#include "SpectrumSummary.h"
+#include "GridFile.h"
+#include "NakazatoReader.h"
 
 #include <TH2D.h>
+#include <TSystem.h>
 #include <TDirectory.h>
+#include <TError.h>
 
 #include <cmath>
-#include <fstream>
+#include <vector>
+#include <memory>
+#include <algorithm>
 using namespace std;
 
+namespace {
+   // end of the time integration of the files in integdata/, in second
+   const Double_t kIntegrationEnd = 20.125;
+}
+
 //______________________________________________________________________________
 //
 
@@ -33,7 +46,28 @@ NEUS::NakazatoModel::NakazatoModel(
 
 void NEUS::NakazatoModel::LoadData(const char *dir)
 {
+   NEUS_PROFILE_SCOPE(fProfiler, kLoadData, 1);
+   SupernovaModel::LoadData(dir); // set fDataLocation
+   if (!LoadBinaryData()) ReadASCIIData();
+   Finalize();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::NakazatoModel::LoadASCIIData(const char *dir)
+{
+   NEUS_PROFILE_SCOPE(fProfiler, kLoadData, 1);
    SupernovaModel::LoadData(dir); // set fDataLocation
+   ReadASCIIData();
+   Finalize();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::NakazatoModel::ReadASCIIData()
+{
    LoadIntegratedData();
    // no full data for the black hole
    if (fInitialMass!=30 || fMetallicity>0.01) LoadFullData();
@@ -44,120 +78,120 @@ void NEUS::NakazatoModel::LoadData(const char *dir)
 
 void NEUS::NakazatoModel::LoadIntegratedData()
 {
+   NEUS_PROFILE_SCOPE(fProfiler, kLoadIntegratedData, 1);
    char *name = Form("%s/integdata/integ%.0f0%.0f.data",
          fDataLocation.Data(), fInitialMass, fReviveTime/100);
    if (fMetallicity<0.01)
       name = Form("%s/integdata/integ%.0f1%.0f.data",
             fDataLocation.Data(), fInitialMass, fReviveTime/100);
 
-   // check database
-   ifstream file(name);
-   if (!(file.is_open())) {
-      Warning("LoadIntegratedData", "%s cannot be read!", name);
+   // load data
+   fIntegratedEdges.assign(fNbinsE+1, 0.);
+   fIntegrated.assign(6*fNbinsE, 0.);
+
+   NakazatoReader reader;
+   if (!reader.ReadIntegrated(name, fNbinsE,
+            &fIntegratedEdges[0], &fIntegrated[0], 1e50)) {
+      Warning("LoadIntegratedData", "%s", reader.Error());
+      fIntegratedEdges.clear();
+      fIntegrated.clear();
       return;
    }
 
-   // skip the first line
-   char line[150];
-   file.getline(line,150);
+   SetIntegratedRanges();
+}
 
-   // load data
-   Double_t binEdges[fNbinsE+1]={0};
-   Double_t number1[fNbinsE];
-   Double_t number2[fNbinsE];
-   Double_t numberx[fNbinsE];
-   Double_t energy1[fNbinsE];
-   Double_t energy2[fNbinsE];
-   Double_t energyx[fNbinsE];
-
-   Double_t energy, n1, n2, nx, e1, e2, ex;
-
-   UShort_t i=0;
-   while(file>>energy>>energy>>n1>>n2>>nx>>e1>>e2>>ex) {
-      number1[i]=n1; number2[i]=n2; numberx[i]=nx; 
-      energy1[i]=e1; energy2[i]=e2; energyx[i]=ex;
-
-      i++;
-      binEdges[i]=energy;
-   }
+//______________________________________________________________________________
+//
 
-   file.close();
+void NEUS::NakazatoModel::SetIntegratedRanges()
+{
+   fMinE = fIntegratedEdges.front();
+   fMaxE = fIntegratedEdges.back();
+   fMaxT = kIntegrationEnd;
+}
 
-   fMinE = binEdges[0];
-   fMaxE = binEdges[fNbinsE];
-   fMaxT = 20.125; // used to set title of histograms for identification
+//______________________________________________________________________________
+//
+
+void NEUS::NakazatoModel::Summarize(SpectrumSummary &summary)
+{
+   SupernovaModel::Summarize(summary);
+   if (fIntegrated.empty()) return;
+   // full data may end earlier or later than the integration
+   const SpectrumGrid *grid = fCore.Grid();
+   if (grid && fabs(grid->TimeAxis().Max()-kIntegrationEnd)
+         >SpectrumModel::fgEndTolerance) return;
+   summary.SetIntegrated(fIntegratedEdges.size()-1, &fIntegratedEdges[0],
+         &fIntegrated[0]);
+}
 
-   // fill spectra
-   for (UShort_t i=1; i<=3; i++) {
-      fHNe[i] = new TH1D(Form("hNe-%s-%d-%.4f", GetName(), i, fMaxT),
-            ";energy [MeV];number of neutrinos [10^{50}/MeV]",fNbinsE,binEdges);
+//______________________________________________________________________________
+//
 
-      fHLe[i] = new TH1D(Form("hLe-%s-%d-%.4f", GetName(), i, fMaxT),
-            ";energy [MeV];luminosity [10^{50} erg/MeV]",fNbinsE,binEdges);
+Bool_t NEUS::NakazatoModel::LoadBinaryData()
+{
+   TString name = BinaryFile();
+   GridFile file;
+   if (!file.Open(name)) {
+      // a missing file is not an error, ASCII files are used instead
+      if (!gSystem->AccessPathName(name))
+         Warning("LoadBinaryData", "%s", file.Error());
+      return kFALSE;
    }
-   for (UShort_t i=4; i<=6; i++) {
-      fHNe[i]=fHNe[3];
-      fHLe[i]=fHLe[3];
+   if (!file.HasIntegrated()) {
+      Warning("LoadBinaryData", "No integrated data in %s!", name.Data());
+      return kFALSE;
    }
 
-   for (i=1; i<=fNbinsE; i++) {
-      fHNe[1]->SetBinContent(i,number1[i-1]/1e50);
-      fHNe[2]->SetBinContent(i,number2[i-1]/1e50);
-      fHNe[3]->SetBinContent(i,numberx[i-1]/1e50);
-
-      fHLe[1]->SetBinContent(i,energy1[i-1]/1e50);
-      fHLe[2]->SetBinContent(i,energy2[i-1]/1e50);
-      fHLe[3]->SetBinContent(i,energyx[i-1]/1e50);
+   fIntegratedEdges.assign(file.IntegratedEdges(),
+         file.IntegratedEdges()+file.IntegratedBins()+1);
+   fIntegrated.assign(file.Integrated(0,0),
+         file.Integrated(0,0)+6*file.IntegratedBins());
+   SetIntegratedRanges();
+
+   if (file.HasGrid()) {
+      SpectrumGrid *grid = new SpectrumGrid;
+      file.MapGrid(*grid);
+      fCore.SetGrid(grid);
+      fMinT = grid->TimeAxis().Min();
+      fMaxT = grid->TimeAxis().Max();
+      fMinE = grid->EnergyAxis().Min();
+      fMaxE = grid->EnergyAxis().Max();
    }
+   return kTRUE;
+}
 
-   // set properties
-   fHNe[1]->SetTitle(GetTitle());
-   fHNe[2]->SetTitle(GetTitle());
-   fHNe[3]->SetTitle(GetTitle());
-
-   fHLe[1]->SetTitle(GetTitle());
-   fHLe[2]->SetTitle(GetTitle());
-   fHLe[3]->SetTitle(GetTitle());
-
-   fHNe[1]->SetStats(0);
-   fHNe[2]->SetStats(0);
-   fHNe[3]->SetStats(0);
-
-   fHLe[1]->SetStats(0);
-   fHLe[2]->SetStats(0);
-   fHLe[3]->SetStats(0);
-
-   fHNe[1]->SetLineColor(kBlack);
-   fHNe[2]->SetLineColor(kRed);
-   fHNe[3]->SetLineColor(kBlue);
-
-   fHLe[1]->SetLineColor(kBlack);
-   fHLe[2]->SetLineColor(kRed);
-   fHLe[3]->SetLineColor(kBlue);
-
-   fHNe[1]->SetMarkerColor(kBlack);
-   fHNe[2]->SetMarkerColor(kRed);
-   fHNe[3]->SetMarkerColor(kBlue);
-
-   fHLe[1]->SetMarkerColor(kBlack);
-   fHLe[2]->SetMarkerColor(kRed);
-   fHLe[3]->SetMarkerColor(kBlue);
-
-   fHNe[1]->SetMarkerStyle(20);
-   fHNe[2]->SetMarkerStyle(20);
-   fHNe[3]->SetMarkerStyle(20);
+//______________________________________________________________________________
+//
 
-   fHLe[1]->SetMarkerStyle(20);
-   fHLe[2]->SetMarkerStyle(20);
-   fHLe[3]->SetMarkerStyle(20);
+Bool_t NEUS::NakazatoModel::SaveBinaryData(const char *file)
+{
+   TString name = file ? file : BinaryFile();
+   if (fIntegrated.empty()) {
+      Warning("SaveBinaryData", "No data loaded from %s!",
+            fDataLocation.Data());
+      return kFALSE;
+   }
+   gSystem->mkdir(gSystem->DirName(name), kTRUE);
+
+   // NULL for the black hole, which has no full data
+   const SpectrumGrid *grid = Grid();
+   string error = GridFile::Write(name, grid,
+         fIntegratedEdges.size()-1, &fIntegratedEdges[0], &fIntegrated[0]);
+   if (!error.empty()) {
+      Warning("SaveBinaryData", "%s", error.c_str());
+      return kFALSE;
+   }
+   return kTRUE;
+}
 
-   fHNe[1]->SetMarkerSize(0.6);
-   fHNe[2]->SetMarkerSize(0.6);
-   fHNe[3]->SetMarkerSize(0.6);
+//______________________________________________________________________________
+//
 
-   fHLe[1]->SetMarkerSize(0.6);
-   fHLe[2]->SetMarkerSize(0.6);
-   fHLe[3]->SetMarkerSize(0.6);
+const char* NEUS::NakazatoModel::BinaryFile()
+{
+   return Form("%s/bindata/%s.bin", fDataLocation.Data(), GetName());
 }
 
 //______________________________________________________________________________
@@ -165,6 +199,7 @@ void NEUS::NakazatoModel::LoadIntegratedData()
 
 void NEUS::NakazatoModel::LoadFullData()
 {
+   NEUS_PROFILE_SCOPE(fProfiler, kLoadFullData, 1);
    if (fInitialMass==30. && fMetallicity<0.01) {
       Warning("LoadFullData", "No full data for black hole");
       Warning("LoadFullData", "with inital mass = 30 Solar mass,");
@@ -178,41 +213,17 @@ void NEUS::NakazatoModel::LoadFullData()
       name = Form("%s/intpdata/intp%.0f1%.0f.data",
             fDataLocation.Data(), fInitialMass, fReviveTime/100);
 
-   // check database
-   ifstream file(name);
-   if (!(file.is_open())) {
-      Warning("LoadFullData", "%s cannot be read!", name);
-      return;
-   }
-
-   // load data
+   // Only bins are read now, contents of a quantity and a flavor are read
+   // the first time they are used, from the file kept in memory until all
+   // of them are.
    Double_t binEdgesx[fNbinsT+1]={0};
    Double_t binEdgesy[fNbinsE+1]={0};
-   Double_t number1[fNbinsT][fNbinsE];
-   Double_t number2[fNbinsT][fNbinsE];
-   Double_t numberx[fNbinsT][fNbinsE];
-   Double_t energy1[fNbinsT][fNbinsE];
-   Double_t energy2[fNbinsT][fNbinsE];
-   Double_t energyx[fNbinsT][fNbinsE];
-
-   Double_t time, energy, n1, n2, nx, e1, e2, ex;
-
-   UShort_t ix=0, iy=0;
-   while(file>>time) {
-      iy=0;
-      while(file>>energy>>energy>>n1>>n2>>nx>>e1>>e2>>ex) {
-         number1[ix][iy]=n1; number2[ix][iy]=n2; numberx[ix][iy]=nx;
-         energy1[ix][iy]=e1; energy2[ix][iy]=e2; energyx[ix][iy]=ex;
-
-         iy++;
-         binEdgesy[iy]=energy;
-         if (iy>=fNbinsE) break;
-      }
-      ix++;
-      binEdgesx[ix]=time;
-   }
 
-   file.close();
+   shared_ptr<NakazatoReader> reader = make_shared<NakazatoReader>();
+   if (!reader->Index(name, fNbinsT, fNbinsE, &binEdgesx[1], binEdgesy)) {
+      Warning("LoadFullData", "%s", reader->Error());
+      return;
+   }
 
    // The time axis in the database is not binned. In order to fill the data
    // into a 2D histogram, a time value in the database is regarded as the
@@ -229,84 +240,19 @@ void NEUS::NakazatoModel::LoadFullData()
    fMinE = binEdgesy[0];
    fMaxE = binEdgesy[fNbinsE];
 
-   // create histograms
-   for (UShort_t i=1; i<=3; i++) {
-      fHN2[i] = new TH2D(Form("hN2%d%.0f%.0f%.0f", i,
-               fInitialMass,fMetallicity*1000,fReviveTime/100),
-            ";time [second];energy [MeV];",
-            fNbinsT,binEdgesx,fNbinsE,binEdgesy);
-
-      fHL2[i] = new TH2D(Form("hL2%d%.0f%.0f%.0f", i,
-               fInitialMass,fMetallicity*1000,fReviveTime/100),
-            ";time [second];energy [MeV];",
-            fNbinsT,binEdgesx,fNbinsE,binEdgesy);
-   }
-   for (UShort_t i=4; i<=6; i++) {
-      fHN2[i]=fHN2[3];
-      fHL2[i]=fHL2[3];
-   }
-
-   // fill spectra
-   for (ix=0; ix<fNbinsT; ix++) {
-      for (iy=0; iy<fNbinsE; iy++) {
-         fHN2[1]->SetBinContent(ix+1,iy+1,number1[ix][iy]/1e50);
-         fHN2[2]->SetBinContent(ix+1,iy+1,number2[ix][iy]/1e50);
-         fHN2[3]->SetBinContent(ix+1,iy+1,numberx[ix][iy]/1e50);
-
-         fHL2[1]->SetBinContent(ix+1,iy+1,energy1[ix][iy]/1e50);
-         fHL2[2]->SetBinContent(ix+1,iy+1,energy2[ix][iy]/1e50);
-         fHL2[3]->SetBinContent(ix+1,iy+1,energyx[ix][iy]/1e50);
-      }
-   }
-
-   // set properties
-   fHN2[1]->GetZaxis()->SetTitle("number of #nu_{e} [10^{50}/s/MeV]");
-   fHN2[2]->GetZaxis()->SetTitle("number of #bar{#nu}_{e} [10^{50}/s/MeV]");
-   fHN2[3]->GetZaxis()->SetTitle("number of #nu_{x} [10^{50}/s/MeV]");
-
-   fHL2[1]->GetZaxis()->SetTitle("luminosity of #nu_{e} [10^{50} erg/s/MeV]");
-   fHL2[2]->GetZaxis()->SetTitle("luminosity of #bar{#nu}_{e} [10^{50} erg/s/MeV]");
-   fHL2[3]->GetZaxis()->SetTitle("luminosity of #nu_{x} [10^{50} erg/s/MeV]");
-
-   fHN2[1]->GetZaxis()->SetTitleOffset(-0.5);
-   fHN2[2]->GetZaxis()->SetTitleOffset(-0.5);
-   fHN2[3]->GetZaxis()->SetTitleOffset(-0.5);
-
-   fHL2[1]->GetZaxis()->SetTitleOffset(-0.5);
-   fHL2[2]->GetZaxis()->SetTitleOffset(-0.5);
-   fHL2[3]->GetZaxis()->SetTitleOffset(-0.5);
-
-   fHN2[1]->GetZaxis()->CenterTitle();
-   fHN2[2]->GetZaxis()->CenterTitle();
-   fHN2[3]->GetZaxis()->CenterTitle();
-
-   fHL2[1]->GetZaxis()->CenterTitle();
-   fHL2[2]->GetZaxis()->CenterTitle();
-   fHL2[3]->GetZaxis()->CenterTitle();
-
-   fHN2[1]->SetTitle(GetTitle());
-   fHN2[2]->SetTitle(GetTitle());
-   fHN2[3]->SetTitle(GetTitle());
-
-   fHL2[1]->SetTitle(GetTitle());
-   fHL2[2]->SetTitle(GetTitle());
-   fHL2[3]->SetTitle(GetTitle());
-
-   fHN2[1]->SetStats(0);
-   fHN2[2]->SetStats(0);
-   fHN2[3]->SetStats(0);
-
-   fHL2[1]->SetStats(0);
-   fHL2[2]->SetStats(0);
-   fHL2[3]->SetStats(0);
-
-   fHN2[1]->SetLineColor(kBlack);
-   fHN2[2]->SetLineColor(kRed);
-   fHN2[3]->SetLineColor(kBlue);
-
-   fHL2[1]->SetLineColor(kBlack);
-   fHL2[2]->SetLineColor(kRed);
-   fHL2[3]->SetLineColor(kBlue);
+   // Histograms are created from the grid when they are requested.
+   // the grid calls its loader under its lock, one block at a time
+   SpectrumGrid *grid = new SpectrumGrid;
+   Profiler *profiler = &fProfiler; // outlives the grid
+   grid->Defer(fNbinsT, binEdgesx, fNbinsE, binEdgesy,
+         [reader, profiler](SpectrumGrid::EQuantity q, UShort_t flavor,
+            Double_t *content) {
+         NEUS_PROFILE_SCOPE(*profiler, kLoadFullData, 1);
+         if (!reader->ReadBlock(q*SpectrumGrid::fgNflavor+flavor, content,
+                  1e50))
+            ::Warning("NakazatoModel::LoadFullData", "%s", reader->Error());
+         });
+   fCore.SetGrid(grid);
 }
 
 //______________________________________________________________________________
@@ -3,6 +3,8 @@
 
 #include "SupernovaModel.h"
 
+#include <vector>
+
 namespace NEUS { class NakazatoModel; }
 
 /**
@@ -22,6 +24,14 @@ class NEUS::NakazatoModel : public SupernovaModel
       static const UShort_t fNbinsT = 391;
       static const UShort_t fNbinsE = 20;
 
+      /**
+       * Time-integrated spectra divided by 1e50.
+       * N(E) of v_e, anti-v_e, v_x, followed by L(E) of them, each with
+       * fIntegratedEdges.size()-1 bins.
+       */
+      std::vector<Double_t> fIntegratedEdges;
+      std::vector<Double_t> fIntegrated;
+
       /**
        * Load data as function of energy and time.
        * The data are divided by 1e50 and then loaded into TH2D objects.
@@ -33,6 +43,28 @@ class NEUS::NakazatoModel : public SupernovaModel
        * The data are divided by 1e50 and then loaded into TH2D objects.
        */
       void LoadIntegratedData();
+      /**
+       * Set the energy range and the end time of fIntegrated.
+       */
+      void SetIntegratedRanges();
+      /**
+       * Load data from BinaryFile() if it exists.
+       * The grid of N(t, E) and L(t, E) is mapped from the file without
+       * being copied. Histograms of them are only created when requested.
+       */
+      Bool_t LoadBinaryData();
+      /**
+       * Load the ASCII files in fDataLocation/integdata and intpdata.
+       */
+      void ReadASCIIData();
+
+   protected:
+      /**
+       * Use fIntegrated as N(E) and L(E) of the full time range if it
+       * covers the same time range as the full data, or if there are no
+       * full data, as for the black hole.
+       */
+      void Summarize(SpectrumSummary &summary);
 
    public:
       NakazatoModel(
@@ -41,15 +73,37 @@ class NEUS::NakazatoModel : public SupernovaModel
             Float_t reviveTime=100 /* ms */);
       ~NakazatoModel() {};
 
-      Double_t InitialMass() { return fInitialMass; }
-      Double_t Metallicity() { return fMetallicity; }
-      Double_t ReviveTime() { return fReviveTime; }
+      Double_t InitialMass() const { return fInitialMass; }
+      Double_t Metallicity() const { return fMetallicity; }
+      Double_t ReviveTime() const { return fReviveTime; }
 
+      /**
+       * Load data from dir.
+       * BinaryFile() is used if it exists, otherwise the ASCII files in
+       * dir/integdata and dir/intpdata are read.
+       */
       void LoadData(const char *dir);
+      /**
+       * Load data from the ASCII files in dir, even if BinaryFile() exists,
+       * e.g. to save it again after the ASCII files changed.
+       */
+      void LoadASCIIData(const char *dir);
+      /**
+       * Binary copy of the ASCII data of this model: dir/bindata/NAME.bin,
+       * where dir is DataLocation() and NAME is GetName().
+       */
+      const char* BinaryFile();
+      /**
+       * Save loaded data to a binary file, BinaryFile() by default.
+       * The following LoadData() calls read the binary file instead of the
+       * ASCII files. It is done for all models by ascii2bin.C, which loads
+       * them with LoadASCIIData().
+       */
+      Bool_t SaveBinaryData(const char *file=0);
 
       void Print();
 
-      ClassDef(NakazatoModel,1);
+      ClassDef(NakazatoModel,2);
 };
 
 #endif
@@ -0,0 +1,248 @@
+#include "NakazatoReader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+using namespace std;
+
+namespace {
+   const unsigned short kNcolumns = 8;
+
+   inline bool IsBlank(char c) { return c==' ' || c=='\t' || c=='\r'; }
+
+   // convert one number starting at p, return the end of it or p on failure
+   inline const char* ParseNumber(const char *p, const char *end, double &value)
+   {
+      const char *begin = p;
+      if (*p=='+') p++; // not accepted by from_chars
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars>=201611L
+      from_chars_result result = from_chars(p, end, value);
+      if (result.ec!=errc()) return begin;
+      return result.ptr;
+#else
+      char *stop;
+      value = strtod(p, &stop);
+      return stop==p ? begin : stop;
+#endif
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::NakazatoReader::NakazatoReader() : fPath(), fBuffer(), fCursor(0),
+   fLine(0), fError(), fRows(), fRowLines(), fUnread(0) {}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::Open(const char *path)
+{
+   fPath = path;
+   fError = "";
+   fBuffer.clear();
+
+   FILE *file = fopen(path, "rb");
+   if (!file) {
+      fError = fPath+" cannot be read";
+      return false;
+   }
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   fseek(file, 0, SEEK_SET);
+   fBuffer.resize(size>0 ? size+1 : 1);
+   size_t n = size>0 ? fread(&fBuffer[0], 1, size, file) : 0;
+   fclose(file);
+   if (size<0 || n!=size_t(size)) {
+      fError = fPath+" cannot be read";
+      return false;
+   }
+   fBuffer[n] = '\0';
+
+   fCursor = &fBuffer[0];
+   fLine = 1;
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::Fail(const char *message)
+{
+   char line[16];
+   snprintf(line, sizeof(line), ":%u: ", fLine);
+   fError = fPath+line+message;
+   return false;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::ReadRow(unsigned short n, double *values,
+      unsigned int columns)
+{
+   const char *end = &fBuffer[0]+fBuffer.size()-1;
+
+   // skip empty lines
+   for (;;) {
+      while (IsBlank(*fCursor)) fCursor++;
+      if (*fCursor!='\n') break;
+      fCursor++;
+      fLine++;
+   }
+   if (fCursor==end) return Fail("unexpected end of file");
+
+   unsigned short i=0;
+   while (fCursor<end && *fCursor!='\n') {
+      if (i<32 && !(columns & (1u<<i))) { // skipped
+         while (fCursor<end && !IsBlank(*fCursor) && *fCursor!='\n')
+            fCursor++;
+         i++;
+         while (IsBlank(*fCursor)) fCursor++;
+         continue;
+      }
+      double value;
+      const char *next = ParseNumber(fCursor, end, value);
+      if (next==fCursor) return Fail("invalid number");
+      if (!IsBlank(*next) && *next!='\n' && next!=end)
+         return Fail("invalid number");
+      if (i<n) values[i] = value;
+      i++;
+      fCursor = next;
+      while (IsBlank(*fCursor)) fCursor++;
+   }
+   if (i!=n) {
+      char message[64];
+      snprintf(message, sizeof(message),
+            "expected %u numbers, found %u", n, i);
+      return Fail(message);
+   }
+   if (*fCursor=='\n') { fCursor++; fLine++; }
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::CheckEnd()
+{
+   const char *end = &fBuffer[0]+fBuffer.size()-1;
+   while (fCursor<end && (IsBlank(*fCursor) || *fCursor=='\n')) {
+      if (*fCursor=='\n') fLine++;
+      fCursor++;
+   }
+   if (fCursor!=end) return Fail("unexpected data after the last row");
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::ReadIntegrated(const char *path,
+      unsigned short nbinsE, double *edges, double *data, double unit)
+{
+   if (!Open(path)) return false;
+
+   // skip the first line
+   while (*fCursor && *fCursor!='\n') fCursor++;
+   if (*fCursor=='\n') { fCursor++; fLine++; }
+
+   double row[kNcolumns];
+   for (unsigned short i=0; i<nbinsE; i++) {
+      if (!ReadRow(kNcolumns, row)) return false;
+      if (i==0) edges[0] = row[0];
+      edges[i+1] = row[1];
+      for (unsigned short j=0; j<6; j++) data[j*nbinsE+i] = row[j+2]/unit;
+   }
+   return CheckEnd();
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::ReadFull(const char *path, unsigned short nbinsT,
+      unsigned short nbinsE, double *times, double *edges, double *content,
+      double unit)
+{
+   if (!Open(path)) return false;
+
+   const size_t size = size_t(nbinsT)*nbinsE; // of one flavor
+   double row[kNcolumns];
+   for (unsigned short it=0; it<nbinsT; it++) {
+      if (!ReadRow(1, &times[it])) return false;
+      for (unsigned short ie=0; ie<nbinsE; ie++) {
+         if (!ReadRow(kNcolumns, row)) return false;
+         if (it==0) {
+            if (ie==0) edges[0] = row[0];
+            edges[ie+1] = row[1];
+         }
+         // N of 3 flavors followed by L of 3 flavors, as in SpectrumGrid
+         for (unsigned short j=0; j<6; j++)
+            content[j*size+it*nbinsE+ie] = row[j+2]/unit;
+      }
+   }
+   return CheckEnd();
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::Index(const char *path, unsigned short nbinsT,
+      unsigned short nbinsE, double *times, double *edges)
+{
+   fRows.clear();
+   fRowLines.clear();
+   fUnread = 0;
+   if (!Open(path)) return false;
+
+   // edges in the first time block, nothing else in data rows
+   fRows.reserve(size_t(nbinsT)*nbinsE);
+   fRowLines.reserve(size_t(nbinsT)*nbinsE);
+   double row[kNcolumns];
+   for (unsigned short it=0; it<nbinsT; it++) {
+      if (!ReadRow(1, &times[it])) return false;
+      for (unsigned short ie=0; ie<nbinsE; ie++) {
+         fRows.push_back(fCursor-&fBuffer[0]);
+         fRowLines.push_back(fLine);
+         if (!ReadRow(kNcolumns, row, it==0 ? 3u : 0u)) return false;
+         if (it==0) {
+            if (ie==0) edges[0] = row[0];
+            edges[ie+1] = row[1];
+         }
+      }
+   }
+   if (!CheckEnd()) return false;
+   fUnread = (1u<<6)-1;
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::NakazatoReader::ReadBlock(unsigned short block, double *content,
+      double unit)
+{
+   if (block>=6 || !(fUnread & (1u<<block))) {
+      fError = fPath+": block not indexed or already read";
+      return false;
+   }
+   fError = "";
+   double row[kNcolumns];
+   for (size_t i=0; i<fRows.size(); i++) {
+      fCursor = &fBuffer[fRows[i]];
+      fLine = fRowLines[i];
+      if (!ReadRow(kNcolumns, row, 1u<<(block+2))) return false;
+      content[i] = row[block+2]/unit;
+   }
+   fUnread &= ~(1u<<block);
+   if (!fUnread) { // release the file
+      vector<char>().swap(fBuffer);
+      vector<unsigned int>().swap(fRows);
+      vector<unsigned int>().swap(fRowLines);
+      fCursor = 0;
+   }
+   return true;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,90 @@
+#ifndef NAKAZATOREADER_H
+#define NAKAZATOREADER_H
+
+#include <string>
+#include <vector>
+
+namespace NEUS { class NakazatoReader; }
+
+/**
+ * Parser of the ASCII files of the Nakazato database.
+ * A file is read into memory in one block and numbers are converted with
+ * std::from_chars, which is much faster than operator>> of std::ifstream.
+ * The number of rows and columns is checked. If a file is malformed,
+ * Error() tells where.
+ *
+ * Each data row contains 8 numbers: lower and upper edges of an energy bin,
+ * dN/dE of v_e, anti-v_e, v_x, and dL/dE of v_e, anti-v_e, v_x.
+ */
+class NEUS::NakazatoReader
+{
+   private:
+      std::string fPath;
+      std::vector<char> fBuffer; // content of the file, ended with '\0'
+      const char *fCursor; // position of the parser
+      unsigned int fLine; // line number of fCursor, counting from 1
+      std::string fError;
+      /**
+       * Positions in fBuffer and line numbers of the data rows found by
+       * Index(), and the blocks ReadBlock() has not read yet.
+       */
+      std::vector<unsigned int> fRows, fRowLines;
+      unsigned int fUnread;
+
+      bool Open(const char *path);
+      /**
+       * Parse the next non-empty line. Number i in it is saved in
+       * values[i] if bit i of columns is set, other numbers are skipped
+       * without being converted. False is returned if the line does not
+       * contain exactly n numbers or if there is no line left.
+       */
+      bool ReadRow(unsigned short n, double *values,
+            unsigned int columns=~0u);
+      bool Fail(const char *message);
+      bool CheckEnd();
+
+   public:
+      NakazatoReader();
+
+      /**
+       * Read a file in integdata/.
+       * The first line is a header, followed by nbinsE data rows.
+       * edges is filled with nbinsE+1 energy bin edges; data with 6*nbinsE
+       * values: N(E) of v_e, anti-v_e, v_x, followed by L(E) of them. Data
+       * values are divided by unit.
+       */
+      bool ReadIntegrated(const char *path, unsigned short nbinsE,
+            double *edges, double *data, double unit=1);
+      /**
+       * Read a file in intpdata/.
+       * It contains nbinsT blocks, each of which is a line with the time
+       * followed by nbinsE data rows. times is filled with nbinsT values,
+       * edges with nbinsE+1 energy bin edges, and content with N(t, E) and
+       * L(t, E) divided by unit, in the layout of SpectrumGrid.
+       */
+      bool ReadFull(const char *path, unsigned short nbinsT,
+            unsigned short nbinsE, double *times, double *edges,
+            double *content, double unit=1);
+      /**
+       * Read times and edges of a file in intpdata/, as ReadFull() does,
+       * and keep the file in memory with the position of each data row,
+       * so that ReadBlock() reads one column without scanning the file
+       * again. Other numbers are skipped without being converted.
+       */
+      bool Index(const char *path, unsigned short nbinsT,
+            unsigned short nbinsE, double *times, double *edges);
+      /**
+       * Read one column of the file given to Index(). block is a quantity
+       * and a flavor, 3*SpectrumGrid::EQuantity+flavor, and its N(t, E) or
+       * L(t, E) are saved in content, which holds nbinsT*nbinsE values.
+       * The file is released once all 6 blocks are read.
+       */
+      bool ReadBlock(unsigned short block, double *content, double unit=1);
+
+      /**
+       * Why the last read failed, in the form of "file:line: reason".
+       */
+      const char* Error() const { return fError.c_str(); }
+};
+
+#endif
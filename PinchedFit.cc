@@ -0,0 +1,199 @@
+#include "PinchedFit.h"
+#include "SpectralMoments.h"
+
+#include <cfloat>
+#include <cmath>
+using namespace std;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NEUS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+const double &NEUS::PinchedFit::fgMaxAlpha = SpectralMoments::fgMaxAlpha;
+
+namespace {
+   const double kMeV = 1.60217646e-6; // erg
+}
+
+//______________________________________________________________________________
+//
+
+#ifdef NEUS_X86_SIMD
+namespace {
+   const double kLn2Hi = 6.93147180369123816490e-01;
+   const double kLn2Lo = 1.90821492927058770002e-10;
+
+   // log of 4 positive, normal numbers: x = m*2^k with m in [sqrt(1/2),
+   // sqrt(2)), log(m) = 2 atanh(s) with s = (m-1)/(m+1), |s|<0.172
+   __attribute__((target("avx2,fma")))
+   inline __m256d LogAVX2(__m256d x)
+   {
+      const __m256i bits = _mm256_castpd_si256(x);
+      // biased exponent turned into a double with the 2^52 trick
+      __m256d k = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(
+                  _mm256_srli_epi64(bits, 52),
+                  _mm256_set1_epi64x(0x4330000000000000LL))),
+            _mm256_set1_pd(4503599627370496.+1023));
+      __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+               _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+               _mm256_set1_epi64x(0x3FF0000000000000LL)));
+      __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(M_SQRT2), _CMP_GT_OQ);
+      m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+      k = _mm256_add_pd(k, _mm256_and_pd(big, _mm256_set1_pd(1.)));
+
+      const __m256d one = _mm256_set1_pd(1.);
+      __m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+      __m256d z = _mm256_mul_pd(s, s);
+      __m256d p = _mm256_set1_pd(1./21);
+      for (int i=19; i>=1; i-=2)
+         p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(1./i));
+      __m256d logm = _mm256_mul_pd(_mm256_add_pd(s, s), p);
+      return _mm256_fmadd_pd(k, _mm256_set1_pd(kLn2Hi),
+            _mm256_fmadd_pd(k, _mm256_set1_pd(kLn2Lo), logm));
+   }
+
+   // exp of 4 numbers, 0 below -708: x = k*log(2) + r with |r|<0.347,
+   // exp(r) from its Taylor series to r^13
+   __attribute__((target("avx2,fma")))
+   inline __m256d ExpAVX2(__m256d x)
+   {
+      __m256d zero = _mm256_cmp_pd(x, _mm256_set1_pd(-708.), _CMP_LT_OQ);
+      x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(709.)),
+            _mm256_set1_pd(-708.));
+      __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(M_LOG2E)),
+            _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+      __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(kLn2Hi), x);
+      r = _mm256_fnmadd_pd(k, _mm256_set1_pd(kLn2Lo), r);
+
+      double factorial = 1;
+      for (int i=2; i<=13; i++) factorial *= i;
+      __m256d p = _mm256_set1_pd(1/factorial);
+      for (int i=13; i>=1; i--) {
+         factorial /= i;
+         p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1/factorial));
+      }
+
+      // 2^k from the exponent bits
+      __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+      e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+      p = _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+      return _mm256_andnot_pd(zero, p);
+   }
+
+   // 4 energies at a time; those that are subnormal or whose exponent is
+   // out of [-708, 709], where LogAVX2 and ExpAVX2 do not hold, are left to
+   // exp() and log() as in the scalar Spectrum()
+   __attribute__((target("avx2,fma")))
+   size_t SpectrumAVX2(double c, double a, double b, const double *energy,
+         double *result, size_t n)
+   {
+      const __m256d vc = _mm256_set1_pd(c), va = _mm256_set1_pd(a),
+            vb = _mm256_set1_pd(-b), zero = _mm256_setzero_pd();
+      size_t k=0;
+      for (; k+4<=n; k+=4) {
+         __m256d e = _mm256_loadu_pd(energy+k);
+         __m256d valid = _mm256_cmp_pd(e, zero, _CMP_GT_OQ);
+         // positive energies also keep log() away from 0 and NaN
+         __m256d x = _mm256_blendv_pd(_mm256_set1_pd(1.), e, valid);
+         __m256d y = _mm256_fmadd_pd(va, LogAVX2(x),
+               _mm256_fmadd_pd(vb, x, vc));
+         __m256d out = _mm256_or_pd(
+               _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_LT_OQ),
+               _mm256_or_pd(
+                  _mm256_cmp_pd(y, _mm256_set1_pd(-708.), _CMP_LT_OQ),
+                  _mm256_cmp_pd(y, _mm256_set1_pd(709.), _CMP_GT_OQ)));
+         if (_mm256_movemask_pd(_mm256_and_pd(out, valid))) {
+            for (size_t j=k; j<k+4; j++) result[j] = energy[j]>0
+               ? exp(c + a*log(energy[j]) - b*energy[j]) : 0;
+            continue;
+         }
+         _mm256_storeu_pd(result+k, _mm256_and_pd(ExpAVX2(y), valid));
+      }
+      return k;
+   }
+}
+#endif
+
+//______________________________________________________________________________
+//
+
+NEUS::PinchedFit::PinchedFit(const SpectrumGrid &grid) : fTaxis(), fL(),
+   fE(), fAlpha(), fC(), fB()
+{
+   if (grid.IsEmpty()) return;
+   const unsigned short nt = grid.TBins();
+   fTaxis.Set(nt, grid.TimeAxis().Edges());
+
+   const size_t size = SpectrumGrid::fgNflavor*nt;
+   fL.assign(size, 0.);
+   fE.assign(size, 0.);
+   fAlpha.assign(size, 0.);
+   fC.assign(size, -HUGE_VAL);
+   fB.assign(size, 0.);
+   const SpectralMoments moments(grid, true);
+   for (unsigned short f=0; f<SpectrumGrid::fgNflavor; f++)
+      for (unsigned short it=0; it<nt; it++) {
+         const double n = moments.Value(SpectralMoments::kN, f, it);
+         const double mean = moments.Value(SpectralMoments::kE, f, it);
+         if (!(n>0 && mean>0)) continue;
+
+         const size_t i = f*nt+it;
+         const double alpha = moments.Value(SpectralMoments::kAlpha, f, it);
+         fL[i] = n*mean*kMeV;
+         fE[i] = mean;
+         fAlpha[i] = alpha;
+         fB[i] = (alpha+1)/mean;
+         fC[i] = log(n) + (alpha+1)*log(alpha+1) - lgamma(alpha+1)
+            - (alpha+1)*log(mean);
+      }
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::PinchedFit::Spectrum(unsigned short flavor, unsigned short it,
+      double energy) const
+{
+   if (!(energy>0)) return 0;
+   const size_t i = flavor*TBins()+it;
+   return exp(fC[i] + fAlpha[i]*log(energy) - fB[i]*energy);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::PinchedFit::Spectrum(unsigned short flavor, unsigned short it,
+      const double *energy, double *result, size_t n) const
+{
+   size_t k=0;
+#ifdef NEUS_X86_SIMD
+   const size_t i = flavor*TBins()+it;
+   if (SpectrumGrid::SIMD()>=SpectrumGrid::kAVX2)
+      k = SpectrumAVX2(fC[i], fAlpha[i], fB[i], energy, result, n);
+#endif
+   for (; k<n; k++) result[k] = Spectrum(flavor, it, energy[k]);
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::PinchedFit::Interpolate(unsigned short flavor, double time,
+      double energy) const
+{
+   int it;
+   double w;
+   if (IsEmpty() || !(energy>0) || !fTaxis.Locate(time, it, w)) return 0;
+   const size_t i = flavor*TBins()+it;
+   if (w==0 || TBins()<2) return Spectrum(flavor, it, energy);
+   if (w==1) return Spectrum(flavor, it+1, energy);
+   // a time bin without neutrinos has none next to it either
+   if (fC[i]==-HUGE_VAL || fC[i+1]==-HUGE_VAL) return 0;
+   const double c = (1-w)*fC[i] + w*fC[i+1];
+   const double a = (1-w)*fAlpha[i] + w*fAlpha[i+1];
+   const double b = (1-w)*fB[i] + w*fB[i+1];
+   return exp(c + a*log(energy) - b*energy);
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,89 @@
+#ifndef PINCHEDFIT_H
+#define PINCHEDFIT_H
+
+#include "SpectrumGrid.h"
+
+#include <vector>
+
+namespace NEUS { class PinchedFit; }
+
+/**
+ * Pinched Fermi-Dirac fit of the energy spectrum in each time bin of a
+ * model, for each flavor, in the form of Keil, Raffelt and Janka,
+ * Astrophys. J. 590 (2003) 971:
+ *
+ *    N(E) = N/<E> (a+1)^(a+1)/Gamma(a+1) (E/<E>)^a exp(-(a+1)E/<E>),
+ *
+ * where N is the number of neutrinos per second, <E> their average energy
+ * and a the pinching parameter, 2.3 for a Fermi-Dirac spectrum without
+ * chemical potential. N, <E> and a are those of SpectralMoments, with
+ * negative contents taken as 0 as in EventSampler, so that <E> is that of
+ * HEt for any model without them, and a is capped at fgMaxAlpha.
+ * The luminosity is N<E>.
+ *
+ * Parameters are turned into log(N(E)) = c + a*log(E) - b*E once, so that
+ * an evaluation is a log and an exp. Spectrum() evaluates energies of one
+ * time bin 4 at a time with AVX2 if SpectrumGrid::SIMD() allows it; the
+ * results agree with the scalar code to about 1e-14 near the peak, and to
+ * 1.2e-13 far in the tail, where exp(y) turns the last bit of y, up to 708
+ * in size, into that much. Subnormal energies, and those whose log(N(E))
+ * is out of [-708, 709], are computed as by the scalar code.
+ * This class does not depend on ROOT.
+ */
+class NEUS::PinchedFit
+{
+   public:
+      static const double &fgMaxAlpha; // SpectralMoments::fgMaxAlpha
+
+   private:
+      GridAxis fTaxis;
+      // fgNflavor*TBins() values, flavor-major
+      std::vector<double> fL, fE, fAlpha;
+      std::vector<double> fC, fB; // see above, fC is -inf without neutrinos
+
+      PinchedFit(const PinchedFit&);
+      PinchedFit& operator=(const PinchedFit&);
+
+   public:
+      /**
+       * Fit all time bins and flavors of grid.
+       */
+      explicit PinchedFit(const SpectrumGrid &grid);
+
+      const GridAxis& TimeAxis() const { return fTaxis; }
+      unsigned short TBins() const { return fTaxis.GetNbins(); }
+      bool IsEmpty() const { return fL.empty(); }
+
+      /**
+       * Parameters of time bin it of a flavor, see SpectrumGrid::Flavor():
+       * luminosity in unit of 1e50 erg/second, average energy in MeV and
+       * pinching parameter.
+       */
+      double L(unsigned short flavor, unsigned short it) const
+      { return fL[flavor*TBins()+it]; }
+      double E(unsigned short flavor, unsigned short it) const
+      { return fE[flavor*TBins()+it]; }
+      double Alpha(unsigned short flavor, unsigned short it) const
+      { return fAlpha[flavor*TBins()+it]; }
+
+      /**
+       * Fitted N(E) in time bin it, in unit of 1e50/MeV/second,
+       * 0 if energy is not positive.
+       */
+      double Spectrum(unsigned short flavor, unsigned short it,
+            double energy) const;
+      /**
+       * Fitted N(E) in time bin it at n energies.
+       */
+      void Spectrum(unsigned short flavor, unsigned short it,
+            const double *energy, double *result, std::size_t n) const;
+      /**
+       * Fitted N(t, E), with c, a and b interpolated linearly in between
+       * centers of time bins as SpectrumGrid::Interpolate() does, i.e.
+       * log(N(E)) is. 0 outside of the time axis.
+       */
+      double Interpolate(unsigned short flavor, double time,
+            double energy) const;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "Profiler.h"
+
+#include <cstdio>
+using namespace std;
+
+namespace {
+   const char *kTimers[] = {"LoadData", "LoadFullData", "LoadIntegratedData",
+      "Fill"};
+   const char *kHistograms[] = {"HNe", "HLe", "HNt", "HLt", "HEt"};
+   const char *kQueries[] = {"N2", "L2", "Ne", "Nt"};
+   const char *kFlavors[] = {"v_e", "anti-v_e", "v_x"};
+
+   // append printf-formatted text to s
+   template<typename... Args>
+   void Append(string &s, const char *format, Args... args)
+   {
+      char line[256];
+      snprintf(line, sizeof(line), format, args...);
+      s += line;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::Profiler::Enabled()
+{
+#ifdef NEUS_PROFILE
+   return true;
+#else
+   return false;
+#endif
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::Profiler::Reset()
+{
+   for (int i=0; i<kNtimers; i++) {
+      fCalls[i] = 0;
+      fNanoseconds[i] = 0;
+   }
+   for (int i=0; i<kNhistograms; i++) fRebuilds[i] = 0;
+   for (int i=0; i<kNqueries; i++)
+      for (int f=0; f<fgNflavor; f++) fQueries[i][f] = 0;
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::Profiler::Snapshot NEUS::Profiler::GetSnapshot() const
+{
+   Snapshot s;
+   s.enabled = Enabled();
+   for (int i=0; i<kNtimers; i++) {
+      s.calls[i] = fCalls[i].load(memory_order_relaxed);
+      s.seconds[i] = fNanoseconds[i].load(memory_order_relaxed)*1e-9;
+   }
+   for (int i=0; i<kNhistograms; i++)
+      s.rebuilds[i] = fRebuilds[i].load(memory_order_relaxed);
+   for (int i=0; i<kNqueries; i++)
+      for (int f=0; f<fgNflavor; f++)
+         s.queries[i][f] = fQueries[i][f].load(memory_order_relaxed);
+   s.histogramBytes = 0;
+   return s;
+}
+
+//______________________________________________________________________________
+//
+
+string NEUS::Profiler::Snapshot::Text(const char *name) const
+{
+   string s;
+   Append(s, "%s%s\n", name, enabled ? "" : " (compiled without NEUS_PROFILE)");
+   for (int i=0; i<kNtimers; i++)
+      Append(s, "  %-20s %12llu calls %12.6f s\n", kTimers[i], calls[i],
+            seconds[i]);
+   for (int i=0; i<kNhistograms; i++)
+      Append(s, "  %-20s %12llu rebuilds\n", kHistograms[i], rebuilds[i]);
+   for (int i=0; i<kNqueries; i++)
+      for (int f=0; f<fgNflavor; f++)
+         Append(s, "  %-20s %12llu points\n",
+               (string(kQueries[i])+" "+kFlavors[f]).c_str(), queries[i][f]);
+   Append(s, "  %-20s %12llu bytes\n", "histograms", histogramBytes);
+   return s;
+}
+
+//______________________________________________________________________________
+//
+
+string NEUS::Profiler::Snapshot::JSON(const char *name) const
+{
+   string s;
+   Append(s, "{\"name\": \"%s\", \"enabled\": %s", name,
+         enabled ? "true" : "false");
+   for (int i=0; i<kNtimers; i++)
+      Append(s, ", \"%s\": {\"calls\": %llu, \"seconds\": %.9f}", kTimers[i],
+            calls[i], seconds[i]);
+   for (int i=0; i<kNhistograms; i++)
+      Append(s, ", \"%s\": {\"rebuilds\": %llu}", kHistograms[i], rebuilds[i]);
+   for (int i=0; i<kNqueries; i++)
+      Append(s, ", \"%s\": {\"%s\": %llu, \"%s\": %llu, \"%s\": %llu}",
+            kQueries[i], kFlavors[0], queries[i][0], kFlavors[1],
+            queries[i][1], kFlavors[2], queries[i][2]);
+   Append(s, ", \"histogramBytes\": %llu}", histogramBytes);
+   return s;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,141 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace NEUS { class Profiler; }
+
+/**
+ * Counters of where a model spends its time.
+ * They are only updated if the library is compiled with NEUS_PROFILE
+ * defined, e.g. by "make PROFILE=1". Otherwise the NEUS_PROFILE_* macros
+ * below expand to nothing, all counters stay 0 and queries do not pay for
+ * them. The layout of the class is the same in both cases, so programs
+ * compiled either way can use the same library.
+ *
+ * Counters are relaxed atomics updated from any thread. A Snapshot taken
+ * while other threads query a model may miss calls in flight.
+ * This class does not depend on ROOT.
+ */
+class NEUS::Profiler
+{
+   public:
+      /**
+       * Timed functions. kFill is the evaluation of Totani's interpolator,
+       * wilson_nl_(), counted per point. Times of functions calling each
+       * other overlap, e.g. kLoadData includes kLoadFullData, which also
+       * counts contents read the first time they are used.
+       */
+      enum ETimer { kLoadData=0, kLoadFullData, kLoadIntegratedData, kFill,
+         kNtimers };
+      /**
+       * Histograms filled by HNe(), HLe(), HNt(), HLt() and HEt() because
+       * they are not in the cache of the model.
+       */
+      enum EHistogram { kHNe=0, kHLe, kHNt, kHLt, kHEt, kNhistograms };
+      /**
+       * Interpolating queries, counted per point.
+       */
+      enum EQuery { kN2=0, kL2, kNe, kNt, kNqueries };
+      static const unsigned short fgNflavor = 3; // see SpectrumGrid::Flavor()
+
+      /**
+       * Copy of all counters at one moment.
+       */
+      struct Snapshot {
+         bool enabled; // whether NEUS_PROFILE was defined
+         unsigned long long calls[kNtimers];
+         double seconds[kNtimers];
+         unsigned long long rebuilds[kNhistograms];
+         unsigned long long queries[kNqueries][fgNflavor];
+         /**
+          * Bytes of bin contents of the histograms a model holds, filled
+          * by SupernovaModel::GetProfile() whether NEUS_PROFILE is defined
+          * or not.
+          */
+         unsigned long long histogramBytes;
+
+         /**
+          * Report of a model called name, as text or as a JSON object.
+          */
+         std::string Text(const char *name) const;
+         std::string JSON(const char *name) const;
+      };
+
+      /**
+       * Add the time it lives to a timer.
+       */
+      class Scope
+      {
+         private:
+            Profiler &fProfiler;
+            ETimer fTimer;
+            unsigned long long fCalls;
+            std::chrono::steady_clock::time_point fStart;
+
+         public:
+            Scope(Profiler &profiler, ETimer timer, unsigned long long calls)
+               : fProfiler(profiler), fTimer(timer), fCalls(calls),
+               fStart(std::chrono::steady_clock::now()) {}
+            ~Scope()
+            {
+               fProfiler.Time(fTimer, fCalls, std::chrono::duration_cast<
+                     std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now()-fStart).count());
+            }
+      };
+
+   private:
+      std::atomic<unsigned long long> fCalls[kNtimers];
+      std::atomic<unsigned long long> fNanoseconds[kNtimers];
+      std::atomic<unsigned long long> fRebuilds[kNhistograms];
+      std::atomic<unsigned long long> fQueries[kNqueries][fgNflavor];
+
+      Profiler(const Profiler&);
+      Profiler& operator=(const Profiler&);
+
+   public:
+      Profiler() { Reset(); }
+
+      /**
+       * Whether the library is compiled with NEUS_PROFILE.
+       */
+      static bool Enabled();
+      void Reset();
+
+      void Time(ETimer timer, unsigned long long calls,
+            unsigned long long nanoseconds)
+      {
+         fCalls[timer].fetch_add(calls, std::memory_order_relaxed);
+         fNanoseconds[timer].fetch_add(nanoseconds, std::memory_order_relaxed);
+      }
+      void Rebuild(EHistogram histogram)
+      { fRebuilds[histogram].fetch_add(1, std::memory_order_relaxed); }
+      void Query(EQuery query, unsigned short flavor, unsigned long long n=1)
+      { fQueries[query][flavor].fetch_add(n, std::memory_order_relaxed); }
+
+      /**
+       * Counters, without histogramBytes.
+       */
+      Snapshot GetSnapshot() const;
+};
+
+#ifdef NEUS_PROFILE
+/**
+ * Time the rest of the enclosing block as calls calls of timer.
+ */
+#define NEUS_PROFILE_SCOPE(profiler, timer, calls) \
+   NEUS::Profiler::Scope neusProfileScope(profiler, \
+         NEUS::Profiler::timer, calls)
+/**
+ * Evaluate a call of a counting function of a Profiler.
+ */
+#define NEUS_PROFILE_COUNT(call) call
+#else
+#define NEUS_PROFILE_SCOPE(profiler, timer, calls)
+#define NEUS_PROFILE_COUNT(call)
+#endif
+
+#endif
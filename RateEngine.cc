@@ -0,0 +1,166 @@
+#include "RateEngine.h"
+#include "SpectrumGrid.h"
+
+#include <cmath>
+using namespace std;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NEUS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+   const double kKpc = 3.0856775814913673e21; // cm
+   const double kAvogadro = 6.02214076e23;
+
+   // sum of a[i]*b[i] with 4 partial sums
+   double Dot(const double *a, const double *b, size_t n)
+   {
+      double s[4] = {0, 0, 0, 0};
+      size_t i=0;
+      for (; i+4<=n; i+=4)
+         for (int k=0; k<4; k++) s[k] += a[i+k]*b[i+k];
+      for (; i<n; i++) s[0] += a[i]*b[i];
+      return (s[0]+s[1])+(s[2]+s[3]);
+   }
+
+#ifdef NEUS_X86_SIMD
+   __attribute__((target("avx2,fma")))
+   double DotAVX2(const double *a, const double *b, size_t n)
+   {
+      __m256d s = _mm256_setzero_pd();
+      size_t i=0;
+      for (; i+4<=n; i+=4)
+         s = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), s);
+      double t[4];
+      _mm256_storeu_pd(t, s);
+      for (; i<n; i++) t[0] += a[i]*b[i];
+      return (t[0]+t[1])+(t[2]+t[3]);
+   }
+#endif
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::RateEngine::Targets(double kton, double molarMass,
+      double perMolecule)
+{
+   return kton*1e9/molarMass*kAvogadro*perMolecule;
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::RateEngine::RateEngine(const SpectrumGrid &grid, double distance) :
+   fGrid(grid), fDistance(distance>0 ? distance : 10), fNe(), fChannels()
+{
+   const unsigned short nt = grid.TBins(), ne = grid.EBins();
+   fNe.assign(SpectrumGrid::fgNflavor*ne, 0.);
+   if (grid.IsEmpty()) return;
+   vector<double> buffer;
+   for (unsigned short f=0; f<SpectrumGrid::fgNflavor; f++) {
+      const double *n = grid.Content(SpectrumGrid::kNumber, f, buffer);
+      for (unsigned short it=0; it<nt; it++)
+         for (unsigned short ie=0; ie<ne; ie++)
+            fNe[f*ne+ie] += n[it*ne+ie]*grid.TimeAxis().BinWidth(it);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::RateEngine::Fluence() const
+{
+   double d = fDistance*kKpc;
+   return 1e50/(4*M_PI*d*d);
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::RateEngine::SetDistance(double distance)
+{
+   if (!(distance>0)) return false;
+   double scale = (fDistance/distance)*(fDistance/distance);
+   fDistance = distance;
+   for (size_t c=0; c<fChannels.size(); c++) {
+      Channel &channel = fChannels[c];
+      for (size_t i=0; i<channel.rate.size(); i++) channel.rate[i] *= scale;
+      for (size_t j=0; j<channel.spectrum.size(); j++)
+         channel.spectrum[j] *= scale;
+      channel.total *= scale;
+   }
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+unsigned short NEUS::RateEngine::AddChannel(const CrossSection &xs,
+      double targets, unsigned short nbins, const double *edges)
+{
+   Channel channel;
+   channel.xs = xs;
+   channel.targets = targets;
+   channel.edges.assign(edges, edges+nbins+1);
+   fChannels.push_back(channel);
+   Compute(fChannels.back());
+   return fChannels.size()-1;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::RateEngine::Compute(Channel &channel) const
+{
+   const unsigned short nf = SpectrumGrid::fgNflavor;
+   const unsigned short nt = fGrid.TBins(), ne = fGrid.EBins();
+   const unsigned short nv = channel.edges.size()-1;
+   channel.weight.assign(nf*ne, 0.);
+   channel.response.assign(nf*ne*nv, 0.);
+   channel.rate.assign(nt, 0.);
+   channel.spectrum.assign(nv, 0.);
+   channel.total = 0;
+   if (fGrid.IsEmpty()) return;
+
+   // cross sections integrated over energy bins, once
+   const double *e = fGrid.EnergyAxis().Edges();
+   for (unsigned short type=1; type<=6; type++) {
+      unsigned short f = SpectrumGrid::Flavor(type);
+      for (unsigned short ie=0; ie<ne; ie++)
+         channel.weight[f*ne+ie] += channel.xs.Integrate(type, e[ie], e[ie+1],
+               nv, &channel.edges[0], &channel.response[(f*ne+ie)*nv]);
+   }
+
+   // energy integral in each time bin
+   double (*dot)(const double*, const double*, size_t) = Dot;
+#ifdef NEUS_X86_SIMD
+   if (SpectrumGrid::SIMD()>=SpectrumGrid::kAVX2) dot = DotAVX2;
+#endif
+   const double scale = Fluence()*channel.targets;
+   vector<double> buffer[nf];
+   const double *n[nf];
+   for (unsigned short f=0; f<nf; f++)
+      n[f] = fGrid.Content(SpectrumGrid::kNumber, f, buffer[f]);
+   for (unsigned short it=0; it<nt; it++) {
+      double sum = 0;
+      for (unsigned short f=0; f<nf; f++)
+         sum += dot(n[f] + it*ne, &channel.weight[f*ne], ne);
+      channel.rate[it] = sum*scale;
+      channel.total += channel.rate[it]*fGrid.TimeAxis().BinWidth(it);
+   }
+
+   // visible energy spectrum of time-integrated N(E)
+   for (unsigned short f=0; f<nf; f++)
+      for (unsigned short ie=0; ie<ne; ie++) {
+         const double n = fNe[f*ne+ie];
+         const double *r = &channel.response[(f*ne+ie)*nv];
+         for (unsigned short j=0; j<nv; j++) channel.spectrum[j] += n*r[j];
+      }
+   for (unsigned short j=0; j<nv; j++)
+      channel.spectrum[j] *= scale/(channel.edges[j+1]-channel.edges[j]);
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,103 @@
+#ifndef RATEENGINE_H
+#define RATEENGINE_H
+
+#include "CrossSection.h"
+
+#include <vector>
+
+namespace NEUS { class RateEngine; class SpectrumGrid; }
+
+/**
+ * Expected events in a detector from N(t, E) of a model.
+ * Each channel is a cross section times a number of targets. Cross
+ * sections summed over the types of a flavor are integrated once per
+ * energy bin of the grid, together with their distribution in visible
+ * energy. N(t, E) is constant in a bin, so the energy integral in each
+ * time bin is then a dot product of a row of the grid with those weights,
+ * done with AVX2 if it is available.
+ *
+ * No flavor transformation is applied: the spectra of the grid are those
+ * reaching the detector. The grid must outlive the engine.
+ * This class does not depend on ROOT.
+ */
+class NEUS::RateEngine
+{
+   public:
+      /**
+       * Number of targets in kton of a material, e.g.
+       * Targets(32, 18.015, 2) for free protons in 32 kton of water,
+       * Targets(40, 39.948, 18) for electrons in 40 kton of argon.
+       */
+      static double Targets(double kton, double molarMass,
+            double perMolecule=1);
+
+   private:
+      struct Channel {
+         CrossSection xs;
+         double targets;
+         std::vector<double> edges; // visible energy bins
+         std::vector<double> weight; // flavors x energy bins
+         std::vector<double> response; // flavors x energy bins x visible bins
+         std::vector<double> rate; // dN/dt in each time bin
+         std::vector<double> spectrum; // dN/dE_vis in each visible bin
+         double total;
+      };
+
+      const SpectrumGrid &fGrid;
+      double fDistance; // kpc
+      std::vector<double> fNe; // time-integrated N(E) of each flavor
+      std::vector<Channel> fChannels;
+
+      /**
+       * 1e50/(4 pi D^2) in cm^-2: neutrinos emitted per unit of the grid
+       * per cm2 at the detector.
+       */
+      double Fluence() const;
+      void Compute(Channel &channel) const;
+
+   public:
+      /**
+       * Rates of neutrinos in grid, which is what SupernovaModel::Grid()
+       * returns, from a source at distance in kpc, 10 kpc if distance is
+       * not positive.
+       */
+      RateEngine(const SpectrumGrid &grid, double distance=10);
+
+      double Distance() const { return fDistance; }
+      /**
+       * Move the source. Results are scaled with 1/distance^2.
+       * False is returned, and nothing is done, if distance is not
+       * positive.
+       */
+      bool SetDistance(double distance);
+
+      /**
+       * Add a channel with a number of targets, see Targets().
+       * nbins visible energy bins are given by nbins+1 edges in MeV.
+       * Its index, counting from 0, is returned.
+       */
+      unsigned short AddChannel(const CrossSection &xs, double targets,
+            unsigned short nbins, const double *edges);
+      unsigned short GetNchannels() const { return fChannels.size(); }
+
+      /**
+       * Events per second in each time bin of the grid, dN/dt.
+       */
+      const double* Rate(unsigned short channel) const
+      { return &fChannels[channel].rate[0]; }
+      /**
+       * Events per MeV in each visible energy bin integrated over time,
+       * dN/dE_vis.
+       */
+      const double* Spectrum(unsigned short channel) const
+      { return &fChannels[channel].spectrum[0]; }
+      const std::vector<double>& VisibleEdges(unsigned short channel) const
+      { return fChannels[channel].edges; }
+      /**
+       * Total number of events.
+       */
+      double Total(unsigned short channel) const
+      { return fChannels[channel].total; }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "SpectralMoments.h"
+
+#include <algorithm>
+using namespace std;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NEUS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+const double NEUS::SpectralMoments::fgMaxAlpha = 100;
+
+namespace {
+   // sums of n*weights[k*ne+ie] for k<3 and of l*weights[3*ne+ie]
+   const unsigned short kNsum = 4;
+
+   // bin ie goes to partial sum ie%4 of each of the kNsum sums, negative
+   // contents are taken as 0 if positive is set
+   void SumsScalar(const double *n, const double *l, const double *weights,
+         unsigned short ne, unsigned short start, bool positive,
+         double *partial)
+   {
+      for (unsigned short ie=start; ie<ne; ie++) {
+         const unsigned short j = ie%4;
+         const double vn = positive ? max(n[ie], 0.) : n[ie];
+         const double vl = positive ? max(l[ie], 0.) : l[ie];
+         partial[j] += vn*weights[ie];
+         partial[4+j] += vn*weights[ne+ie];
+         partial[8+j] += vn*weights[2*ne+ie];
+         partial[12+j] += vl*weights[3*ne+ie];
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+#ifdef NEUS_X86_SIMD
+namespace {
+   // products and sums are not fused, so that lanes match the scalar code
+   __attribute__((target("avx2")))
+   unsigned short SumsAVX2(const double *n, const double *l,
+         const double *weights, unsigned short ne, bool positive,
+         double *partial)
+   {
+      const __m256d zero = _mm256_setzero_pd();
+      __m256d s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+      unsigned short ie=0;
+      for (; ie+4<=ne; ie+=4) {
+         __m256d vn = _mm256_loadu_pd(n+ie), vl = _mm256_loadu_pd(l+ie);
+         if (positive) {
+            vn = _mm256_max_pd(vn, zero);
+            vl = _mm256_max_pd(vl, zero);
+         }
+         s0 = _mm256_add_pd(s0, _mm256_mul_pd(vn, _mm256_loadu_pd(weights+ie)));
+         s1 = _mm256_add_pd(s1,
+               _mm256_mul_pd(vn, _mm256_loadu_pd(weights+ne+ie)));
+         s2 = _mm256_add_pd(s2,
+               _mm256_mul_pd(vn, _mm256_loadu_pd(weights+2*ne+ie)));
+         s3 = _mm256_add_pd(s3,
+               _mm256_mul_pd(vl, _mm256_loadu_pd(weights+3*ne+ie)));
+      }
+      _mm256_storeu_pd(partial, s0);
+      _mm256_storeu_pd(partial+4, s1);
+      _mm256_storeu_pd(partial+8, s2);
+      _mm256_storeu_pd(partial+12, s3);
+      return ie;
+   }
+}
+#endif
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectralMoments::SpectralMoments(const SpectrumGrid &grid,
+      bool positive) : fTaxis(), fValues()
+{
+   for (unsigned short f=0; f<fgNflavor; f++)
+      for (unsigned short m=0; m<fgNmoment; m++) fIntegrated[f][m] = 0;
+   if (grid.IsEmpty()) return;
+   const unsigned short nt = grid.TBins(), ne = grid.EBins();
+   fTaxis.Set(nt, grid.TimeAxis().Edges());
+   const GridAxis &eaxis = grid.EnergyAxis();
+   const double *edges = eaxis.Edges();
+
+   // weights of energy bins: dE, E dE, E^2 dE integrated over the bin, and
+   // dE for L, times the weights of L if it is derived from N
+   const double *derived = grid.LuminosityWeights();
+   vector<double> weights(kNsum*ne);
+   for (unsigned short ie=0; ie<ne; ie++) {
+      const double e0 = edges[ie], e1 = edges[ie+1];
+      weights[ie] = e1-e0;
+      weights[ne+ie] = (e1-e0)*eaxis.Centers()[ie];
+      weights[2*ne+ie] = (e1*e1*e1-e0*e0*e0)/3;
+      weights[3*ne+ie] = derived ? (e1-e0)*derived[ie] : e1-e0;
+   }
+
+   fValues.assign(fgNflavor*fgNmoment*nt, 0.);
+   vector<double> bufferN, bufferL;
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      const double *cn = grid.Content(SpectrumGrid::kNumber, f, bufferN);
+      const double *cl = derived ? cn
+         : grid.Content(SpectrumGrid::kLuminosity, f, bufferL);
+      double total[kNsum] = {0, 0, 0, 0};
+      for (unsigned short it=0; it<nt; it++) {
+         const double *n = cn+it*ne, *l = cl+it*ne;
+         double partial[4*kNsum] = {0};
+         unsigned short start = 0;
+#ifdef NEUS_X86_SIMD
+         if (SpectrumGrid::SIMD()>=SpectrumGrid::kAVX2)
+            start = SumsAVX2(n, l, &weights[0], ne, positive, partial);
+#endif
+         SumsScalar(n, l, &weights[0], ne, start, positive, partial);
+
+         double sums[kNsum], moments[fgNmoment];
+         for (unsigned short k=0; k<kNsum; k++) {
+            const double *p = partial+4*k;
+            sums[k] = (p[0]+p[1]) + (p[2]+p[3]);
+            total[k] += sums[k]*fTaxis.BinWidth(it);
+         }
+         Moments(sums, moments);
+         for (unsigned short m=0; m<fgNmoment; m++)
+            fValues[(f*fgNmoment+m)*nt+it] = moments[m];
+      }
+      Moments(total, fIntegrated[f]);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectralMoments::Moments(const double *sums, double *moments)
+{
+   const double n = sums[0];
+   moments[kN] = n;
+   moments[kL] = sums[3];
+   moments[kE] = moments[kE2] = moments[kAlpha] = 0;
+   if (!(n>0 && sums[1]>0)) return;
+
+   const double mean = sums[1]/n, m2 = sums[2]/n, variance = m2-mean*mean;
+   const double alpha = variance>0 ? (2*mean*mean-m2)/variance : fgMaxAlpha;
+   moments[kE] = mean;
+   moments[kE2] = m2;
+   moments[kAlpha] = min(alpha, fgMaxAlpha);
+}
+
+//______________________________________________________________________________
+//
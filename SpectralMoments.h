@@ -0,0 +1,89 @@
+#ifndef SPECTRALMOMENTS_H
+#define SPECTRALMOMENTS_H
+
+#include "SpectrumGrid.h"
+
+#include <vector>
+
+namespace NEUS { class SpectralMoments; }
+
+/**
+ * Energy moments of N(t, E) and L(t, E) of a grid in each time bin and over
+ * the whole time axis, for all flavors:
+ *
+ *    N(t)      number of neutrinos, in unit of 1e50/second, as in HNt,
+ *    L(t)      luminosity, in unit of 1e50 erg/second, as in HLt,
+ *    <E>(t)    average energy in MeV, as in HEt,
+ *    <E^2>(t)  average squared energy in MeV^2,
+ *    alpha(t)  pinching parameter, from <E^2>/<E>^2 = (a+2)/(a+1).
+ *
+ * Contents are taken as constant in each bin, so that <E> weights bin
+ * centers and <E^2> integrates E^2 over each bin, as PinchedFit does.
+ * Everything is computed when the object is built, in one pass over the
+ * rows of each flavor: a row of N(E) is read once for N, <E> and <E^2>,
+ * with weights of energy bins tabulated beforehand, and L(t, E) derived
+ * from N(t, E) is not read at all, see SpectrumGrid::DeriveLuminosity().
+ * Sums over energy are made 4 bins at a time with AVX2 if
+ * SpectrumGrid::SIMD() allows it, into 4 partial sums which the scalar code
+ * keeps too, so that results do not depend on SIMD(). They agree with the
+ * cumulative tables of SpectrumSummary to rounding.
+ *
+ * Integrated moments are sums over time bins of N and L and of the energy
+ * moments weighted by N, so that the integrated <E> is that of N(E)
+ * integrated over time. It is Eave() only if L(t, E) is N(t, E) times the
+ * bin centers. alpha and moments other than N and L are 0 in bins without
+ * neutrinos. This class does not depend on ROOT.
+ */
+class NEUS::SpectralMoments
+{
+   public:
+      enum EMoment { kN=0, kL=1, kE=2, kE2=3, kAlpha=4 };
+      static const unsigned short fgNmoment = 5;
+      static const unsigned short fgNflavor = SpectrumGrid::fgNflavor;
+      static const double fgMaxAlpha; // of spectra narrower than that
+
+   private:
+      GridAxis fTaxis;
+      // fgNflavor*fgNmoment rows of TBins() values, flavor-major
+      std::vector<double> fValues;
+      double fIntegrated[fgNflavor][fgNmoment];
+
+      /**
+       * Turn sums of n, l, n*E and n*E^2 into N, L, <E>, <E^2> and alpha.
+       */
+      static void Moments(const double *sums, double *moments);
+
+      SpectralMoments(const SpectralMoments&);
+      SpectralMoments& operator=(const SpectralMoments&);
+
+   public:
+      /**
+       * Compute all moments of grid. If positive is set, negative contents
+       * are taken as 0, as EventSampler does when it samples them.
+       */
+      explicit SpectralMoments(const SpectrumGrid &grid,
+            bool positive=false);
+
+      const GridAxis& TimeAxis() const { return fTaxis; }
+      unsigned short TBins() const { return fTaxis.GetNbins(); }
+      bool IsEmpty() const { return fValues.empty(); }
+
+      /**
+       * Moment m of a flavor, see SpectrumGrid::Flavor(), in time bin it.
+       */
+      double Value(EMoment m, unsigned short flavor, unsigned short it) const
+      { return fValues[(flavor*fgNmoment+m)*TBins()+it]; }
+      /**
+       * TBins() values of moment m of a flavor, one per time bin.
+       */
+      const double* Row(EMoment m, unsigned short flavor) const
+      { return &fValues[(flavor*fgNmoment+m)*TBins()]; }
+      /**
+       * Moment m of a flavor over the whole time axis: N in unit of 1e50,
+       * L in unit of 1e50 erg, as Nall() and Lall() give them.
+       */
+      double Integrated(EMoment m, unsigned short flavor) const
+      { return fIntegrated[flavor][m]; }
+};
+
+#endif
@@ -0,0 +1,728 @@
+#include "SpectrumGrid.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NEUS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+   const size_t kAlignment = 64; // size of a cache line
+
+   // allocate n zeroed objects aligned to a cache line
+   template<typename T> T* AlignedAlloc(size_t n)
+   {
+      size_t size = (n*sizeof(T)+kAlignment-1)/kAlignment*kAlignment;
+      void *p = aligned_alloc(kAlignment, size>0?size:kAlignment);
+      if (p) memset(p, 0, size);
+      return static_cast<T*>(p);
+   }
+
+   // Codes of n contents v of a row in SpectrumGrid::kLog16, and the scale
+   // of the row. The step is rounded to float before the codes are made.
+   void EncodeLog16(const double *v, unsigned short n, unsigned short *codes,
+         float &logMin, float &logStep)
+   {
+      double low = HUGE_VAL, high = -HUGE_VAL;
+      for (unsigned short i=0; i<n; i++)
+         if (v[i]>0) { low = min(low, log(v[i])); high = max(high, log(v[i])); }
+      logMin = logStep = 0;
+      if (!(low<=high)) { fill(codes, codes+n, 0); return; }
+      logMin = static_cast<float>(low);
+      logStep = static_cast<float>((high-logMin)/65534);
+      for (unsigned short i=0; i<n; i++) {
+         if (!(v[i]>0)) codes[i] = 0;
+         else if (logStep==0) codes[i] = 1;
+         else {
+            double c = floor((log(v[i])-logMin)/logStep+0.5);
+            codes[i] = static_cast<unsigned short>(1+max(0., min(c, 65534.)));
+         }
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::GridAxis::GridAxis() : fNbins(0), fEdges(0), fCenters(0), fInvDist(0),
+   fLookup(0), fNcells(0), fScale(0) {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridAxis::Clear()
+{
+   free(fEdges); free(fCenters); free(fInvDist); free(fLookup);
+   fEdges=0; fCenters=0; fInvDist=0; fLookup=0;
+   fNbins=0; fNcells=0; fScale=0;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::GridAxis::Set(unsigned short nbins, const double *edges)
+{
+   Clear();
+   if (nbins==0) return;
+
+   fNbins = nbins;
+   fEdges = AlignedAlloc<double>(nbins+1);
+   fCenters = AlignedAlloc<double>(nbins);
+   fInvDist = AlignedAlloc<double>(nbins);
+   copy(edges, edges+nbins+1, fEdges);
+   for (unsigned short i=0; i<nbins; i++)
+      fCenters[i] = (fEdges[i]+fEdges[i+1])/2.;
+   for (unsigned short i=0; i+1<nbins; i++)
+      fInvDist[i] = 1./(fCenters[i+1]-fCenters[i]);
+
+   // The cell size is the narrowest bin width so that most lookups land
+   // directly in the right bin, but the table is limited to 16 cells per bin
+   // to keep it in cache for axes with a few very narrow bins.
+   double range = fEdges[nbins]-fEdges[0];
+   double minWidth = range;
+   for (unsigned short i=0; i<nbins; i++)
+      if (fEdges[i+1]-fEdges[i]>0 && fEdges[i+1]-fEdges[i]<minWidth)
+         minWidth = fEdges[i+1]-fEdges[i];
+   double ncells = ceil(range/minWidth);
+   if (ncells<nbins) ncells = nbins;
+   if (ncells>16.*nbins) ncells = 16.*nbins;
+   fNcells = static_cast<unsigned int>(ncells);
+   fScale = fNcells/range;
+
+   // padded so that vectorized code can read entries as 64-bit integers
+   fLookup = AlignedAlloc<unsigned short>(fNcells+4);
+   for (unsigned int c=0; c<fNcells; c++) {
+      double x = fEdges[0] + c/fScale;
+      int i = upper_bound(fEdges, fEdges+nbins+1, x) - fEdges - 1;
+      fLookup[c] = static_cast<unsigned short>(max(0, min(i, nbins-1)));
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectrumGrid::SpectrumGrid() : fTaxis(), fEaxis(), fStorage(kDouble),
+   fMode(Interpolator::kLinear), fOwner(), fWeights(0), fLoader(),
+   fMissing(0), fMutex()
+{
+   for (unsigned short b=0; b<fgNblock; b++) {
+      fData[b] = 0; fFloat[b] = 0; fCode[b] = 0;
+      fLogMin[b] = 0; fLogStep[b] = 0;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Release(unsigned short b)
+{
+   if (!fOwner) free(fData[b]);
+   free(fFloat[b]); free(fCode[b]); free(fLogMin[b]); free(fLogStep[b]);
+   fData[b] = 0; fFloat[b] = 0; fCode[b] = 0; fLogMin[b] = 0; fLogStep[b] = 0;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Clear()
+{
+   for (unsigned short b=0; b<fgNblock; b++) {
+      Release(b);
+      fInterpolators[b].Clear();
+   }
+   fOwner.reset();
+   free(fWeights);
+   fWeights = 0;
+   fLoader = Loader();
+   fMissing.store(0, memory_order_relaxed);
+   fStorage = kDouble;
+   fMode = Interpolator::kLinear;
+   fTaxis.Clear();
+   fEaxis.Clear();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Create(unsigned short nbinsT, const double *edgesT,
+      unsigned short nbinsE, const double *edgesE)
+{
+   Clear();
+   fTaxis.Set(nbinsT, edgesT);
+   fEaxis.Set(nbinsE, edgesE);
+   for (unsigned short b=0; b<fgNblock; b++)
+      fData[b] = AlignedAlloc<double>(size_t(TBins())*EBins());
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Adopt(unsigned short nbinsT, const double *edgesT,
+      unsigned short nbinsE, const double *edgesE,
+      const double *data, const shared_ptr<const void> &owner)
+{
+   Clear();
+   fTaxis.Set(nbinsT, edgesT);
+   fEaxis.Set(nbinsE, edgesE);
+   const size_t n = size_t(TBins())*EBins();
+   for (unsigned short b=0; b<fgNblock; b++)
+      fData[b] = const_cast<double*>(data) + b*n;
+   fOwner = owner;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Defer(unsigned short nbinsT, const double *edgesT,
+      unsigned short nbinsE, const double *edgesE, const Loader &loader)
+{
+   Clear();
+   fTaxis.Set(nbinsT, edgesT);
+   fEaxis.Set(nbinsE, edgesE);
+   if (IsEmpty()) return;
+   fLoader = loader;
+   fMissing.store((1u<<fgNblock)-1, memory_order_release);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::DeriveLuminosity(const double *weights)
+{
+   if (IsEmpty()) return;
+   lock_guard<mutex> lock(fMutex);
+   if (!fWeights) fWeights = AlignedAlloc<double>(EBins());
+   copy(weights, weights+EBins(), fWeights);
+   for (unsigned short b=fgNflavor; b<fgNblock; b++) {
+      Release(b);
+      fInterpolators[b].Clear(); // made with those of N, see Load()
+   }
+   // L is loaded with N
+   fMissing.fetch_and((1u<<fgNflavor)-1, memory_order_release);
+   if (fMode==Interpolator::kLinear) return;
+   vector<double> buffer(size_t(TBins())*EBins());
+   for (unsigned short b=fgNflavor; b<fgNblock; b++) {
+      if (!IsLoaded(EQuantity(b/fgNflavor), b%fgNflavor)) continue;
+      Widen(b, &buffer[0]);
+      fInterpolators[b].Set(fMode, fTaxis, &fEaxis, &buffer[0]);
+      fInterpolators[b].ReleaseValues();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Widen(unsigned short b, double *buffer) const
+{
+   const unsigned short s = Stored(b), ne = EBins();
+   const size_t n = size_t(TBins())*ne;
+   for (size_t i=0; i<n; i++) buffer[i] = Value(s, i);
+   if (s!=b)
+      for (size_t i=0; i<n; i++) buffer[i] *= fWeights[i%ne];
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Load(unsigned short b) const
+{
+   lock_guard<mutex> lock(fMutex);
+   if (!(fMissing.load(memory_order_acquire) & (1u<<b))) return; // by another
+   // loading does not change what the grid represents
+   SpectrumGrid *self = const_cast<SpectrumGrid*>(this);
+   const size_t n = size_t(TBins())*EBins();
+   self->fData[b] = AlignedAlloc<double>(n);
+   if (fLoader) fLoader(EQuantity(b/fgNflavor), b%fgNflavor, fData[b]);
+   if (fMode!=Interpolator::kLinear) { // from the contents just loaded
+      Interpolator &interpolator = self->fInterpolators[b];
+      interpolator.Set(fMode, fTaxis, &fEaxis, fData[b]);
+      interpolator.ReleaseValues();
+      if (fWeights && b<fgNflavor) { // of L derived from them
+         vector<double> l(n);
+         for (size_t i=0; i<n; i++) l[i] = fData[b][i]*fWeights[i%EBins()];
+         Interpolator &derived = self->fInterpolators[b+fgNflavor];
+         derived.Set(fMode, fTaxis, &fEaxis, &l[0]);
+         derived.ReleaseValues();
+      }
+   }
+   if (fStorage!=kDouble) self->Convert(b, kDouble, fStorage);
+   fMissing.fetch_and(~(1u<<b), memory_order_release);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::SetInterpolation(Interpolator::EMode mode)
+{
+   if (TBins()<2 || EBins()<2) mode = Interpolator::kLinear;
+   lock_guard<mutex> lock(fMutex);
+   fMode = mode;
+   vector<double> buffer; // contents in compact storage
+   for (unsigned short b=0; b<fgNblock; b++) {
+      Interpolator &interpolator = fInterpolators[b];
+      if (IsEmpty() || !IsLoaded(EQuantity(b/fgNflavor), b%fgNflavor))
+         interpolator.Clear(); // made in Load()
+      else {
+         interpolator.Set(mode, fTaxis, &fEaxis,
+               Content(EQuantity(b/fgNflavor), b%fgNflavor, buffer));
+         // contents may be converted, or be in buffer, see Interpolate()
+         interpolator.ReleaseValues();
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+const double* NEUS::SpectrumGrid::Content(EQuantity q, unsigned short flavor,
+      vector<double> &buffer) const
+{
+   const unsigned short b = q*fgNflavor+flavor;
+   Require(Stored(b));
+   if (fStorage==kDouble && Stored(b)==b) return fData[b];
+   const size_t n = size_t(TBins())*EBins();
+   buffer.resize(n);
+   if (n>0) Widen(b, &buffer[0]);
+   return n>0 ? &buffer[0] : 0;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Convert(unsigned short b, EStorage from,
+      EStorage storage)
+{
+   const size_t size = size_t(TBins())*EBins();
+   const unsigned short ne = EBins();
+
+   // contents in double, widened if they are compact
+   double *data = fData[b];
+   if (from!=kDouble) { // from Storage()
+      data = AlignedAlloc<double>(size);
+      for (size_t i=0; i<size; i++) data[i] = Value(b, i);
+   }
+
+   float *values = 0, *logMin = 0, *logStep = 0;
+   unsigned short *codes = 0;
+   if (storage==kFloat) {
+      values = AlignedAlloc<float>(size);
+      for (size_t i=0; i<size; i++) values[i] = static_cast<float>(data[i]);
+   } else if (storage==kLog16) {
+      const size_t nrows = size/ne;
+      codes = AlignedAlloc<unsigned short>(size);
+      logMin = AlignedAlloc<float>(nrows);
+      logStep = AlignedAlloc<float>(nrows);
+      for (size_t r=0; r<nrows; r++)
+         EncodeLog16(data+r*ne, ne, codes+r*ne, logMin[r], logStep[r]);
+   }
+
+   if (storage==kDouble) { // data were widened above
+      Release(b);
+      fData[b] = data;
+   } else {
+      if (data!=fData[b]) free(data);
+      Release(b);
+      fFloat[b] = values;
+      fCode[b] = codes;
+      fLogMin[b] = logMin;
+      fLogStep[b] = logStep;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::SetStorage(EStorage storage)
+{
+   if (IsEmpty() || storage==fStorage) return;
+   lock_guard<mutex> lock(fMutex);
+   for (unsigned short b=0; b<fgNblock; b++)
+      if (Stored(b)==b && IsLoaded(EQuantity(b/fgNflavor), b%fgNflavor))
+         Convert(b, fStorage, storage);
+   // adopted contents are either all converted or all not loaded
+   fOwner.reset();
+   fStorage = storage;
+}
+
+//______________________________________________________________________________
+//
+
+size_t NEUS::SpectrumGrid::ContentBytes() const
+{
+   if (IsEmpty() || IsAdopted()) return 0;
+   const size_t size = size_t(TBins())*EBins();
+   size_t bytes = 0;
+   for (unsigned short b=0; b<fgNblock; b++) {
+      if (Stored(b)!=b || !IsLoaded(EQuantity(b/fgNflavor), b%fgNflavor))
+         continue;
+      switch (fStorage) {
+         case kFloat: bytes += size*sizeof(float); break;
+         case kLog16: bytes += size*sizeof(unsigned short)
+                      + 2*TBins()*sizeof(float); break;
+         default: bytes += size*sizeof(double);
+      }
+   }
+   return bytes;
+}
+
+//______________________________________________________________________________
+//
+
+#ifdef NEUS_X86_SIMD
+// GCC 12 warns about the deliberately undefined source vectors of gathers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+namespace {
+   // Bin search of GridAxis::Locate() on 4 points.
+   // Lanes outside of the axis are cleared in valid.
+   __attribute__((target("avx2,fma")))
+   inline void LocateAVX2(const NEUS::GridAxis &axis, __m256d x,
+         __m256i &i, __m256d &w, __m256d &valid)
+   {
+      const double *edges = axis.Edges();
+      const double *centers = axis.Centers();
+      const __m256d min = _mm256_set1_pd(edges[0]);
+      const __m256d max = _mm256_set1_pd(edges[axis.GetNbins()]);
+      valid = _mm256_and_pd(_mm256_cmp_pd(x, min, _CMP_GE_OQ),
+            _mm256_cmp_pd(x, max, _CMP_LT_OQ));
+      x = _mm256_blendv_pd(min, x, valid);
+
+      // coarse table
+      __m128i cell = _mm256_cvttpd_epi32(
+            _mm256_mul_pd(_mm256_sub_pd(x, min), _mm256_set1_pd(axis.Scale())));
+      cell = _mm_min_epi32(cell, _mm_set1_epi32(axis.Ncells()-1));
+      __m128i bin = _mm_and_si128(_mm_i32gather_epi32(
+               reinterpret_cast<const int*>(axis.Lookup()), cell, 2),
+            _mm_set1_epi32(0xFFFF));
+      i = _mm256_cvtepi32_epi64(bin);
+
+      // walk over bin edges, the comparison gives -1 in lanes to be moved
+      const __m256i one = _mm256_set1_epi64x(1);
+      for (;;) {
+         __m256d up = _mm256_i64gather_pd(edges, _mm256_add_epi64(i, one), 8);
+         __m256d m = _mm256_cmp_pd(x, up, _CMP_GE_OQ);
+         if (!_mm256_movemask_pd(m)) break;
+         i = _mm256_sub_epi64(i, _mm256_castpd_si256(m));
+      }
+      for (;;) {
+         __m256d low = _mm256_i64gather_pd(edges, i, 8);
+         __m256d m = _mm256_cmp_pd(x, low, _CMP_LT_OQ);
+         if (!_mm256_movemask_pd(m)) break;
+         i = _mm256_add_epi64(i, _mm256_castpd_si256(m));
+      }
+
+      // left or right of the bin center
+      __m256d m = _mm256_cmp_pd(x, _mm256_i64gather_pd(centers, i, 8),
+            _CMP_LT_OQ);
+      i = _mm256_add_epi64(i, _mm256_castpd_si256(m));
+
+      // clamp to the outermost bin centers
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i last = _mm256_set1_epi64x(axis.GetNbins()-2);
+      __m256d below = _mm256_castsi256_pd(_mm256_cmpgt_epi64(zero, i));
+      __m256d above = _mm256_castsi256_pd(_mm256_cmpgt_epi64(i, last));
+      i = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(i),
+               _mm256_castsi256_pd(zero), below));
+      i = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(i),
+               _mm256_castsi256_pd(last), above));
+      w = _mm256_mul_pd(
+            _mm256_sub_pd(x, _mm256_i64gather_pd(centers, i, 8)),
+            _mm256_i64gather_pd(axis.InvDist(), i, 8));
+      w = _mm256_blendv_pd(w, _mm256_setzero_pd(), below);
+      w = _mm256_blendv_pd(w, _mm256_set1_pd(1.), above);
+   }
+
+   // contents at 4 indices, widened to double
+   __attribute__((target("avx2,fma")))
+   inline __m256d GatherAVX2(const double *content, __m256i i)
+   { return _mm256_i64gather_pd(content, i, 8); }
+   __attribute__((target("avx2,fma")))
+   inline __m256d GatherAVX2(const float *content, __m256i i)
+   { return _mm256_cvtps_pd(_mm256_i64gather_ps(content, i, 4)); }
+
+   // contents times weights of their energy bins if weighted
+   template<typename T, bool weighted> __attribute__((target("avx2,fma")))
+   size_t InterpolateAVX2(const NEUS::GridAxis &taxis,
+         const NEUS::GridAxis &eaxis, const T *content, const double *weights,
+         const double *time, const double *energy, double *result, size_t n)
+   {
+      const __m256i ne = _mm256_set1_epi64x(eaxis.GetNbins());
+      const __m256i one = _mm256_set1_epi64x(1);
+      size_t k=0;
+      for (; k+4<=n; k+=4) {
+         __m256i it, ie;
+         __m256d wt, we, vt, ve;
+         LocateAVX2(taxis, _mm256_loadu_pd(time+k), it, wt, vt);
+         LocateAVX2(eaxis, _mm256_loadu_pd(energy+k), ie, we, ve);
+
+         __m256i i00 = _mm256_add_epi64(_mm256_mul_epu32(it, ne), ie);
+         __m256i i10 = _mm256_add_epi64(i00, ne);
+         __m256d c00 = GatherAVX2(content, i00);
+         __m256d c01 = GatherAVX2(content, _mm256_add_epi64(i00, one));
+         __m256d c10 = GatherAVX2(content, i10);
+         __m256d c11 = GatherAVX2(content, _mm256_add_epi64(i10, one));
+         if (weighted) {
+            __m256d w0 = _mm256_i64gather_pd(weights, ie, 8);
+            __m256d w1 = _mm256_i64gather_pd(weights,
+                  _mm256_add_epi64(ie, one), 8);
+            c00 = _mm256_mul_pd(c00, w0);
+            c01 = _mm256_mul_pd(c01, w1);
+            c10 = _mm256_mul_pd(c10, w0);
+            c11 = _mm256_mul_pd(c11, w1);
+         }
+
+         // (1-w)*a + w*b as in the scalar code, since a + w*(b-a) loses
+         // digits of results much smaller than a or b in steep spectra
+         const __m256d ue = _mm256_sub_pd(_mm256_set1_pd(1.), we);
+         const __m256d ut = _mm256_sub_pd(_mm256_set1_pd(1.), wt);
+         __m256d c0 = _mm256_fmadd_pd(we, c01, _mm256_mul_pd(ue, c00));
+         __m256d c1 = _mm256_fmadd_pd(we, c11, _mm256_mul_pd(ue, c10));
+         __m256d c = _mm256_fmadd_pd(wt, c1, _mm256_mul_pd(ut, c0));
+         c = _mm256_and_pd(c, _mm256_and_pd(vt, ve));
+         _mm256_storeu_pd(result+k, c);
+      }
+      return k;
+   }
+
+   // Bin search of GridAxis::Locate() on 8 points.
+   __attribute__((target("avx512f")))
+   inline void LocateAVX512(const NEUS::GridAxis &axis, __m512d x,
+         __m512i &i, __m512d &w, __mmask8 &valid)
+   {
+      const double *edges = axis.Edges();
+      const double *centers = axis.Centers();
+      const __m512d min = _mm512_set1_pd(edges[0]);
+      const __m512d max = _mm512_set1_pd(edges[axis.GetNbins()]);
+      valid = _mm512_cmp_pd_mask(x, min, _CMP_GE_OQ)
+         & _mm512_cmp_pd_mask(x, max, _CMP_LT_OQ);
+      x = _mm512_mask_blend_pd(valid, min, x);
+
+      // coarse table
+      __m256i cell = _mm512_cvttpd_epi32(
+            _mm512_mul_pd(_mm512_sub_pd(x, min), _mm512_set1_pd(axis.Scale())));
+      cell = _mm256_min_epi32(cell, _mm256_set1_epi32(axis.Ncells()-1));
+      i = _mm512_and_si512(_mm512_i32gather_epi64(cell,
+               reinterpret_cast<const long long*>(axis.Lookup()), 2),
+            _mm512_set1_epi64(0xFFFF));
+
+      // walk over bin edges
+      const __m512i one = _mm512_set1_epi64(1);
+      for (;;) {
+         __m512d up = _mm512_i64gather_pd(_mm512_add_epi64(i, one), edges, 8);
+         __mmask8 m = _mm512_cmp_pd_mask(x, up, _CMP_GE_OQ);
+         if (!m) break;
+         i = _mm512_mask_add_epi64(i, m, i, one);
+      }
+      for (;;) {
+         __m512d low = _mm512_i64gather_pd(i, edges, 8);
+         __mmask8 m = _mm512_cmp_pd_mask(x, low, _CMP_LT_OQ);
+         if (!m) break;
+         i = _mm512_mask_sub_epi64(i, m, i, one);
+      }
+
+      // left or right of the bin center
+      __mmask8 m = _mm512_cmp_pd_mask(x, _mm512_i64gather_pd(i, centers, 8),
+            _CMP_LT_OQ);
+      i = _mm512_mask_sub_epi64(i, m, i, one);
+
+      // clamp to the outermost bin centers
+      const __m512i zero = _mm512_setzero_si512();
+      const __m512i last = _mm512_set1_epi64(axis.GetNbins()-2);
+      __mmask8 below = _mm512_cmplt_epi64_mask(i, zero);
+      __mmask8 above = _mm512_cmpgt_epi64_mask(i, last);
+      i = _mm512_mask_blend_epi64(below, i, zero);
+      i = _mm512_mask_blend_epi64(above, i, last);
+      w = _mm512_mul_pd(
+            _mm512_sub_pd(x, _mm512_i64gather_pd(i, centers, 8)),
+            _mm512_i64gather_pd(i, axis.InvDist(), 8));
+      w = _mm512_mask_blend_pd(below, w, _mm512_setzero_pd());
+      w = _mm512_mask_blend_pd(above, w, _mm512_set1_pd(1.));
+   }
+
+   __attribute__((target("avx512f")))
+   inline __m512d GatherAVX512(const double *content, __m512i i)
+   { return _mm512_i64gather_pd(i, content, 8); }
+   __attribute__((target("avx512f")))
+   inline __m512d GatherAVX512(const float *content, __m512i i)
+   { return _mm512_cvtps_pd(_mm512_i64gather_ps(i, content, 4)); }
+
+   template<typename T, bool weighted> __attribute__((target("avx512f")))
+   size_t InterpolateAVX512(const NEUS::GridAxis &taxis,
+         const NEUS::GridAxis &eaxis, const T *content, const double *weights,
+         const double *time, const double *energy, double *result, size_t n)
+   {
+      const __m512i ne = _mm512_set1_epi64(eaxis.GetNbins());
+      const __m512i one = _mm512_set1_epi64(1);
+      size_t k=0;
+      for (; k+8<=n; k+=8) {
+         __m512i it, ie;
+         __m512d wt, we;
+         __mmask8 vt, ve;
+         LocateAVX512(taxis, _mm512_loadu_pd(time+k), it, wt, vt);
+         LocateAVX512(eaxis, _mm512_loadu_pd(energy+k), ie, we, ve);
+
+         __m512i i00 = _mm512_add_epi64(_mm512_mul_epu32(it, ne), ie);
+         __m512i i10 = _mm512_add_epi64(i00, ne);
+         __m512d c00 = GatherAVX512(content, i00);
+         __m512d c01 = GatherAVX512(content, _mm512_add_epi64(i00, one));
+         __m512d c10 = GatherAVX512(content, i10);
+         __m512d c11 = GatherAVX512(content, _mm512_add_epi64(i10, one));
+         if (weighted) {
+            __m512d w0 = _mm512_i64gather_pd(ie, weights, 8);
+            __m512d w1 = _mm512_i64gather_pd(_mm512_add_epi64(ie, one),
+                  weights, 8);
+            c00 = _mm512_mul_pd(c00, w0);
+            c01 = _mm512_mul_pd(c01, w1);
+            c10 = _mm512_mul_pd(c10, w0);
+            c11 = _mm512_mul_pd(c11, w1);
+         }
+
+         const __m512d ue = _mm512_sub_pd(_mm512_set1_pd(1.), we);
+         const __m512d ut = _mm512_sub_pd(_mm512_set1_pd(1.), wt);
+         __m512d c0 = _mm512_fmadd_pd(we, c01, _mm512_mul_pd(ue, c00));
+         __m512d c1 = _mm512_fmadd_pd(we, c11, _mm512_mul_pd(ue, c10));
+         __m512d c = _mm512_fmadd_pd(wt, c1, _mm512_mul_pd(ut, c0));
+         c = _mm512_maskz_mov_pd(vt & ve, c);
+         _mm512_storeu_pd(result+k, c);
+      }
+      return k;
+   }
+
+   // InterpolateAVX512() or InterpolateAVX2(), weighted if weights are given
+   template<typename T>
+   size_t InterpolateSIMD(bool avx512, const NEUS::GridAxis &taxis,
+         const NEUS::GridAxis &eaxis, const T *content, const double *weights,
+         const double *time, const double *energy, double *result, size_t n)
+   {
+      if (avx512)
+         return weights ? InterpolateAVX512<T, true>(taxis, eaxis, content,
+               weights, time, energy, result, n)
+            : InterpolateAVX512<T, false>(taxis, eaxis, content,
+                  weights, time, energy, result, n);
+      return weights ? InterpolateAVX2<T, true>(taxis, eaxis, content,
+            weights, time, energy, result, n)
+         : InterpolateAVX2<T, false>(taxis, eaxis, content,
+               weights, time, energy, result, n);
+   }
+}
+#pragma GCC diagnostic pop
+#endif
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectrumGrid::ESIMD NEUS::SpectrumGrid::fgSIMD
+   = NEUS::SpectrumGrid::SupportedSIMD();
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectrumGrid::ESIMD NEUS::SpectrumGrid::SupportedSIMD()
+{
+#ifdef NEUS_X86_SIMD
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f")) return kAVX512;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return kAVX2;
+#endif
+   return kScalar;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::SetSIMD(ESIMD level)
+{
+   ESIMD supported = SupportedSIMD();
+   fgSIMD = level>supported ? supported : level;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Interpolate(EQuantity q, unsigned short flavor,
+      const double *time, const double *energy, double *result, size_t n) const
+{
+   const unsigned short b = q*fgNflavor+flavor, s = Stored(b);
+   Require(s);
+   size_t k=0;
+#ifdef NEUS_X86_SIMD
+   // the vectorized code assumes at least 2 bins on both axes
+   if (TBins()>1 && EBins()>1 && Interpolation()==Interpolator::kLinear
+         && fgSIMD!=kScalar) {
+      const double *weights = s!=b ? fWeights : 0;
+      if (fStorage==kDouble)
+         k = InterpolateSIMD(fgSIMD==kAVX512, fTaxis, fEaxis, fData[s],
+               weights, time, energy, result, n);
+      else if (fStorage==kFloat)
+         k = InterpolateSIMD(fgSIMD==kAVX512, fTaxis, fEaxis, fFloat[s],
+               weights, time, energy, result, n);
+   }
+#endif
+   for (; k<n; k++) result[k] = Interpolate(q, flavor, time[k], energy[k]);
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumGrid::Mix(EQuantity q, const double *weights,
+      double time, double energy) const
+{
+   double sum = 0;
+   if (Interpolation()!=Interpolator::kLinear) {
+      for (unsigned short f=0; f<fgNflavor; f++)
+         if (weights[f]!=0) sum += weights[f]*Interpolate(q, f, time, energy);
+      return sum;
+   }
+   int it, ie;
+   double wt, we;
+   if (!fTaxis.Locate(time, it, wt)) return 0;
+   if (!fEaxis.Locate(energy, ie, we)) return 0;
+   const unsigned short ne = EBins();
+   const int dt = TBins()>1 ? ne : 0, de = ne>1 ? 1 : 0;
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      if (weights[f]==0) continue;
+      const unsigned short b = q*fgNflavor+f, s = Stored(b);
+      Require(s);
+      const double w0 = s!=b ? fWeights[ie] : 1;
+      const double w1 = s!=b ? fWeights[ie+de] : 1;
+      if (fStorage!=kDouble) {
+         const size_t i = it*ne + ie;
+         sum += weights[f]*((1-wt)*((1-we)*Value(s, i)*w0
+                  + we*Value(s, i+de)*w1)
+               + wt*((1-we)*Value(s, i+dt)*w0 + we*Value(s, i+dt+de)*w1));
+         continue;
+      }
+      const double *c = fData[s] + it*ne + ie;
+      sum += weights[f]*((1-wt)*((1-we)*c[0]*w0 + we*c[de]*w1)
+            + wt*((1-we)*c[dt]*w0 + we*c[dt+de]*w1));
+   }
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumGrid::Mix(EQuantity q, const double *weights,
+      const double *time, const double *energy, double *result, size_t n) const
+{
+   fill(result, result+n, 0.);
+   const size_t chunk = 256;
+   double values[chunk];
+   for (size_t first=0; first<n; first+=chunk) {
+      const size_t m = min(chunk, n-first);
+      for (unsigned short f=0; f<fgNflavor; f++) {
+         if (weights[f]==0) continue;
+         Interpolate(q, f, time+first, energy+first, values, m);
+         for (size_t k=0; k<m; k++) result[first+k] += weights[f]*values[k];
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
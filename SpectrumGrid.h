@@ -0,0 +1,429 @@
+#ifndef SPECTRUMGRID_H
+#define SPECTRUMGRID_H
+
+#include "Interpolator.h"
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include <functional>
+
+namespace NEUS { class GridAxis; class SpectrumGrid; }
+
+/**
+ * Non-uniformly binned axis with an O(1) bin lookup.
+ * The range [Min(), Max()) is cut into equal cells. Each cell remembers the
+ * bin containing its lower boundary, so that finding a bin takes one
+ * multiplication, one table read and at most a few steps over bin edges.
+ */
+class NEUS::GridAxis
+{
+   private:
+      unsigned short fNbins;
+      double *fEdges;   // fNbins+1 bin edges
+      double *fCenters; // fNbins bin centers
+      double *fInvDist; // 1/(fCenters[i+1]-fCenters[i])
+
+      unsigned short *fLookup; // bin containing the lower boundary of a cell
+      unsigned int fNcells;
+      double fScale; // number of cells per unit of x
+
+      GridAxis(const GridAxis&);
+      GridAxis& operator=(const GridAxis&);
+
+   public:
+      GridAxis();
+      ~GridAxis() { Clear(); }
+
+      void Clear();
+      /**
+       * Set bin edges.
+       * edges must be an array of nbins+1 increasing values.
+       */
+      void Set(unsigned short nbins, const double *edges);
+
+      unsigned short GetNbins() const { return fNbins; }
+      double Min() const { return fEdges?fEdges[0]:0; }
+      double Max() const { return fEdges?fEdges[fNbins]:0; }
+      const double* Edges() const { return fEdges; }
+      const double* Centers() const { return fCenters; }
+      double BinWidth(unsigned short i) const { return fEdges[i+1]-fEdges[i]; }
+      const double* InvDist() const { return fInvDist; }
+      const unsigned short* Lookup() const { return fLookup; }
+      unsigned int Ncells() const { return fNcells; }
+      double Scale() const { return fScale; }
+
+      /**
+       * Index of the bin containing x, counting from 0.
+       * -1 is returned if x is not in [Min(), Max()).
+       */
+      int FindBin(double x) const
+      {
+         if (!(x>=fEdges[0] && x<fEdges[fNbins])) return -1;
+         unsigned int cell = static_cast<unsigned int>((x-fEdges[0])*fScale);
+         if (cell>=fNcells) cell=fNcells-1;
+         int i = fLookup[cell];
+         while (x>=fEdges[i+1]) i++;
+         while (x<fEdges[i]) i--;
+         return i;
+      }
+      /**
+       * Locate x in between bin centers for linear interpolation.
+       * The value at x is (1-w)*v[i] + w*v[i+1]. Outside the outermost bin
+       * centers the value of the outermost bin is used, which is what
+       * TH1::Interpolate does. False is returned if x is not in the axis.
+       */
+      bool Locate(double x, int &i, double &w) const
+      {
+         i = FindBin(x);
+         if (i<0) return false;
+         if (x<fCenters[i]) i--;
+         if (i<0) { i=0; w=0; }
+         else if (i>=fNbins-1) { i=fNbins>1?fNbins-2:0; w=fNbins>1?1:0; }
+         else w = (x-fCenters[i])*fInvDist[i];
+         return true;
+      }
+      /**
+       * Locate a cutoff x for integrals: [Min(), x] covers the first k bins
+       * and the fraction frac of bin k. k is GetNbins() from Max() on.
+       */
+      void Cut(double x, unsigned short &k, double &frac) const
+      {
+         k = 0;
+         frac = 0;
+         if (x<=Min()) return;
+         if (x>=Max()) { k = fNbins; return; }
+         k = FindBin(x);
+         frac = (x-fEdges[k])/BinWidth(k);
+      }
+};
+
+/**
+ * Flat storage of N(t, E) and L(t, E) for fast interpolation.
+ * Contents of each quantity and distinct flavor (v_e, anti-v_e and v_x) are
+ * kept in a 64-byte aligned block, time-major: the energy spectrum at a
+ * given time is a contiguous row of EBins() values. Blocks can be loaded
+ * the first time they are used, see Defer(), and kept in less precise,
+ * smaller storage, see SetStorage(). L(t, E) that is N(t, E) times a
+ * function of energy need not be stored at all, see DeriveLuminosity().
+ * This class does not depend on ROOT. TH2D objects in SupernovaModel are
+ * filled from the same data and are only needed for visualization.
+ */
+class NEUS::SpectrumGrid
+{
+   public:
+      /**
+       * Quantities saved in the grid.
+       * kNumber: number of neutrinos, in unit of 1e50/MeV/second.
+       * kLuminosity: luminosity, in unit of 1e50*erg/MeV/second.
+       */
+      enum EQuantity { kNumber=0, kLuminosity=1 };
+      static const unsigned short fgNquantity = 2;
+      /**
+       * Number of distinct flavors: v_e, anti-v_e and v_x.
+       */
+      static const unsigned short fgNflavor = 3;
+      /**
+       * Convert neutrino type (1-6, see SupernovaModel) to flavor index.
+       * Types 3, 4, 5, 6 share the same v_x spectrum.
+       */
+      static unsigned short Flavor(unsigned short type)
+      { return type<3 ? type-1 : 2; }
+      /**
+       * Instruction sets used by the batched Interpolate().
+       */
+      enum ESIMD { kScalar=0, kAVX2=1, kAVX512=2 };
+      /**
+       * Best instruction set supported by both the compiler and the CPU.
+       */
+      static ESIMD SupportedSIMD();
+      /**
+       * Instruction set used by the batched Interpolate().
+       * It is SupportedSIMD() by default. It can be lowered, for example, to
+       * compare vectorized and scalar results, but not raised above
+       * SupportedSIMD().
+       */
+      static ESIMD SIMD() { return fgSIMD; }
+      static void SetSIMD(ESIMD level);
+      /**
+       * Storage of contents, see SetStorage().
+       * kDouble: 8 bytes per bin, the default.
+       * kFloat: 4 bytes per bin.
+       * kLog16: 2 bytes per bin, logarithms saved in 16 bits.
+       */
+      enum EStorage { kDouble=0, kFloat=1, kLog16=2 };
+      /**
+       * Function filling the contents of a quantity and a flavor, laid out
+       * as in Content(), which are zeroed beforehand. See Defer().
+       */
+      typedef std::function<void(EQuantity q, unsigned short flavor,
+            double *content)> Loader;
+
+   private:
+      static ESIMD fgSIMD;
+      static const unsigned short fgNblock = fgNquantity*fgNflavor;
+
+      GridAxis fTaxis, fEaxis;
+      EStorage fStorage;
+      Interpolator::EMode fMode;
+      /**
+       * Contents of quantity q and flavor f in block q*fgNflavor+f, in
+       * Storage(): doubles, floats, or 16-bit codes with the scale of each
+       * row of EBins() codes, i.e. of each time bin. Code 0 stands for
+       * contents <= 0, code c>0 for exp(fLogMin[row]+(c-1)*fLogStep[row]).
+       */
+      double *fData[fgNblock];
+      float *fFloat[fgNblock];
+      unsigned short *fCode[fgNblock];
+      float *fLogMin[fgNblock], *fLogStep[fgNblock];
+      std::shared_ptr<const void> fOwner; // keeps external contents alive
+      double *fWeights; // of DeriveLuminosity(), NULL if L is stored
+      /**
+       * Tables of SetInterpolation() for each block.
+       */
+      Interpolator fInterpolators[fgNblock];
+
+      Loader fLoader; // of Defer()
+      /**
+       * Bit b is set while block b is not loaded yet. It is cleared after
+       * the block is filled, so that a reader seeing it cleared sees the
+       * contents.
+       */
+      mutable std::atomic<unsigned int> fMissing;
+      mutable std::mutex fMutex; // serializes Load()
+
+      /**
+       * Block holding the contents of block b: that of N if b is L derived
+       * from it, see DeriveLuminosity().
+       */
+      unsigned short Stored(unsigned short b) const
+      { return fWeights && b>=fgNflavor ? b-fgNflavor : b; }
+      /**
+       * Free contents of block b in any storage.
+       */
+      void Release(unsigned short b);
+      /**
+       * Load block b with fLoader, in Storage() and with the table of
+       * Interpolation(), if it is not loaded yet.
+       */
+      void Load(unsigned short b) const;
+      void Require(unsigned short b) const
+      { if (fMissing.load(std::memory_order_acquire) & (1u<<b)) Load(b); }
+      /**
+       * Widen contents of block b into buffer, applying fWeights if it is
+       * derived.
+       */
+      void Widen(unsigned short b, double *buffer) const;
+      /**
+       * Convert block b, loaded, from kDouble or Storage() to storage.
+       */
+      void Convert(unsigned short b, EStorage from, EStorage storage);
+      /**
+       * Content i of block b, stored, widened to double.
+       */
+      double Value(unsigned short b, std::size_t i) const
+      {
+         if (fStorage==kFloat) return fFloat[b][i];
+         if (fStorage==kDouble) return fData[b][i];
+         const std::size_t row = i/EBins();
+         return fCode[b][i] ? std::exp(fLogMin[b][row]
+               + (fCode[b][i]-1)*double(fLogStep[b][row])) : 0;
+      }
+
+      SpectrumGrid(const SpectrumGrid&);
+      SpectrumGrid& operator=(const SpectrumGrid&);
+
+   public:
+      SpectrumGrid();
+      ~SpectrumGrid() { Clear(); }
+
+      void Clear();
+      /**
+       * Set up binning and allocate zeroed contents.
+       */
+      void Create(unsigned short nbinsT, const double *edgesT,
+            unsigned short nbinsE, const double *edgesE);
+
+      /**
+       * Set up binning and use contents saved elsewhere, for example in a
+       * memory-mapped file, without copying them.
+       * data must hold all blocks one after another, quantity-major, then
+       * flavor-major, and stay valid as long as owner is held. Only the
+       * bin edges are copied.
+       */
+      void Adopt(unsigned short nbinsT, const double *edgesT,
+            unsigned short nbinsE, const double *edgesE,
+            const double *data, const std::shared_ptr<const void> &owner);
+      /**
+       * Set up binning and fill the contents of a quantity and a flavor
+       * with loader the first time they are used, by a query, Content()
+       * or anything reading them. Memory is only allocated for those. The
+       * loader is called once per quantity and flavor, by one thread at a
+       * time, and must not use this grid.
+       */
+      void Defer(unsigned short nbinsT, const double *edgesT,
+            unsigned short nbinsE, const double *edgesE, const Loader &loader);
+      /**
+       * Whether contents of a quantity and a flavor are in memory, or
+       * mapped, see Defer().
+       */
+      bool IsLoaded(EQuantity q, unsigned short flavor) const
+      { return !(fMissing.load(std::memory_order_acquire)
+            & (1u<<Stored(q*fgNflavor+flavor))); }
+      /**
+       * Compute L(t, E) as N(t, E)*weights[ie] in energy bin ie from now
+       * on, instead of storing it, e.g. with weights of E*1.60217646e-6
+       * erg for a grid of N(t, E) in 1/MeV. Stored contents of L are
+       * freed, or released if they are adopted; L is made from N where it
+       * is interpolated, integrated or widened, see Content(). It has to
+       * be called after Create(), Adopt() or Defer(), before contents are
+       * used. Nothing is done to an empty grid.
+       */
+      void DeriveLuminosity(const double *weights);
+      /**
+       * Weights of DeriveLuminosity(), one per energy bin, or NULL if L is
+       * stored.
+       */
+      const double* LuminosityWeights() const { return fWeights; }
+
+      bool IsEmpty() const { return TBins()==0; }
+      /**
+       * Whether contents are owned by something else, see Adopt().
+       * Such contents may be read-only.
+       */
+      bool IsAdopted() const { return fOwner.get()!=0; }
+      /**
+       * Number of contents, i.e. fgNquantity*fgNflavor*TBins()*EBins().
+       */
+      std::size_t Size() const
+      { return std::size_t(fgNquantity)*fgNflavor*TBins()*EBins(); }
+
+      const GridAxis& TimeAxis() const { return fTaxis; }
+      const GridAxis& EnergyAxis() const { return fEaxis; }
+      unsigned short TBins() const { return fTaxis.GetNbins(); }
+      unsigned short EBins() const { return fEaxis.GetNbins(); }
+
+      /**
+       * Contents of a quantity for a flavor, loaded if needed.
+       * Bin (it, ie) is at Content(q,f)[it*EBins()+ie].
+       * NULL is returned unless the storage is kDouble, and for L derived
+       * from N, see DeriveLuminosity().
+       */
+      double* Content(EQuantity q, unsigned short flavor)
+      {
+         const unsigned short b = q*fgNflavor+flavor;
+         Require(Stored(b));
+         return fData[b];
+      }
+      const double* Content(EQuantity q, unsigned short flavor) const
+      {
+         const unsigned short b = q*fgNflavor+flavor;
+         Require(Stored(b));
+         return fData[b];
+      }
+      /**
+       * Contents of a quantity for a flavor in any storage, laid out as by
+       * Content(q, flavor): they are returned directly for kDouble, and
+       * are otherwise widened, or derived, into buffer, which is resized
+       * as needed.
+       */
+      const double* Content(EQuantity q, unsigned short flavor,
+            std::vector<double> &buffer) const;
+
+      /**
+       * Keep contents in storage from now on. Loaded contents are
+       * converted, and the old ones are freed, or released if they are
+       * adopted; the others are converted when they are loaded.
+       * kFloat rounds each content to the nearest float, a relative error
+       * of at most 6e-8. kLog16 saves ln(v) of contents v>0 in 65535 steps
+       * from the smallest to the largest one of each time bin of a
+       * quantity and a flavor, a relative error of at most
+       * exp(step/2)-1, e.g. 3.5e-4 for contents spanning 20 decades in a
+       * time bin, and saves contents <=0 as 0. Converting back to kDouble
+       * does not recover the lost precision. Interpolation tables other
+       * than those of Interpolator::kLinear are not changed and stay in
+       * double. Nothing is done to an empty grid.
+       */
+      void SetStorage(EStorage storage);
+      EStorage Storage() const { return fStorage; }
+      /**
+       * Memory used by loaded contents in bytes, 0 for adopted ones and
+       * for derived L.
+       */
+      std::size_t ContentBytes() const;
+
+      /**
+       * Interpolate contents with mode from now on, see Interpolator.
+       * Tables are made from the current contents, so it has to be called
+       * again whenever they change. Contents that are not loaded get
+       * theirs when they are loaded. Create(), Adopt(), Defer() and
+       * Clear() go back to Interpolator::kLinear. Grids with less than 2
+       * bins on an axis always use Interpolator::kLinear.
+       */
+      void SetInterpolation(Interpolator::EMode mode);
+      Interpolator::EMode Interpolation() const { return fMode; }
+
+      /**
+       * Interpolation between bin centers, see SetInterpolation().
+       * By default it is bilinear, identical to TH2::Interpolate.
+       * Contents in compact storage are widened to double, and derived L
+       * is weighted, before they are blended. 0 is returned outside of
+       * the grid.
+       */
+      double Interpolate(EQuantity q, unsigned short flavor,
+            double time, double energy) const
+      {
+         const unsigned short b = q*fgNflavor+flavor, s = Stored(b);
+         Require(s);
+         const Interpolator &interpolator = fInterpolators[b];
+         if (interpolator.Mode()!=Interpolator::kLinear) {
+            const double value = interpolator.Evaluate(time, energy);
+            if (value==value) return value;
+            // cells of contents <= 0 are interpolated linearly below
+         }
+         int it, ie;
+         double wt, we;
+         if (!fTaxis.Locate(time, it, wt)) return 0;
+         if (!fEaxis.Locate(energy, ie, we)) return 0;
+         const unsigned short ne = EBins();
+         const int dt = TBins()>1 ? ne : 0, de = ne>1 ? 1 : 0;
+         const double w0 = s!=b ? fWeights[ie] : 1;
+         const double w1 = s!=b ? fWeights[ie+de] : 1;
+         if (fStorage!=kDouble) {
+            const std::size_t i = it*ne + ie;
+            return (1-wt)*((1-we)*Value(s, i)*w0 + we*Value(s, i+de)*w1)
+               + wt*((1-we)*Value(s, i+dt)*w0 + we*Value(s, i+dt+de)*w1);
+         }
+         const double *c = fData[s] + it*ne + ie;
+         return (1-wt)*((1-we)*c[0]*w0 + we*c[de]*w1)
+            + wt*((1-we)*c[dt]*w0 + we*c[dt+de]*w1);
+      }
+      /**
+       * Interpolate at n points (time[i], energy[i]) and save the results
+       * in result[i]. Bin search, weights and the bilinear blend are done
+       * on 4 (AVX2) or 8 (AVX-512) points at a time, kFloat contents are
+       * widened as they are gathered, and derived L is weighted. Results
+       * agree with the scalar Interpolate() within rounding errors. kLog16
+       * contents and other modes of SetInterpolation() run point by point.
+       */
+      void Interpolate(EQuantity q, unsigned short flavor,
+            const double *time, const double *energy,
+            double *result, std::size_t n) const;
+      /**
+       * Sum of weights[f]*Interpolate(q, f, time, energy) over the
+       * fgNflavor flavors, with one bin search if the interpolation is
+       * linear. Flavors of weight 0 are skipped.
+       */
+      double Mix(EQuantity q, const double *weights,
+            double time, double energy) const;
+      /**
+       * Mix() at n points, using the batched Interpolate().
+       */
+      void Mix(EQuantity q, const double *weights, const double *time,
+            const double *energy, double *result, std::size_t n) const;
+};
+
+#endif
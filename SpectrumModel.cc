@@ -0,0 +1,237 @@
+#include "SpectrumModel.h"
+#include "GridFile.h"
+
+using namespace std;
+
+const double NEUS::SpectrumModel::fgEndTolerance = 5e-5;
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectrumModel::SpectrumModel() : fGrid(0), fSummary(0),
+   fInterpolation(Interpolator::kLinear), fStorage(SpectrumGrid::kDouble),
+   fError() {}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::Clear()
+{
+   if (fGrid) delete fGrid;
+   fGrid = 0;
+   delete fSummary.exchange(0);
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::SpectrumModel::Load(const char *path, double tmax)
+{
+   Clear();
+   GridFile file;
+   if (!file.Open(path)) {
+      fError = file.Error();
+      return false;
+   }
+   if (!file.HasGrid() && !file.HasIntegrated()) {
+      fError = string("No data in ") + path;
+      return false;
+   }
+   fError.clear();
+
+   if (file.HasGrid()) {
+      SpectrumGrid *grid = new SpectrumGrid;
+      file.MapGrid(*grid);
+      SetGrid(grid);
+   }
+   SpectrumSummary *summary = new SpectrumSummary;
+   if (fGrid) summary->Fill(*fGrid);
+   // the integration may end earlier or later than the grid
+   if (file.HasIntegrated()
+         && (!fGrid || fabs(fGrid->TimeAxis().Max()-tmax)<=fgEndTolerance))
+      summary->SetIntegrated(file.IntegratedBins(), file.IntegratedEdges(),
+            file.Integrated(0,0));
+   SetSummary(summary);
+   return true;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::SetGrid(SpectrumGrid *grid)
+{
+   delete fSummary.exchange(0);
+   if (fGrid && fGrid!=grid) delete fGrid;
+   fGrid = grid;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::SetSummary(SpectrumSummary *summary)
+{
+   summary->SetInterpolation(fInterpolation);
+   if (fGrid) fGrid->SetInterpolation(fInterpolation);
+   if (fGrid) fGrid->SetStorage(fStorage);
+   // publish after everything above is done
+   delete fSummary.exchange(summary, memory_order_acq_rel);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::SetInterpolation(Interpolator::EMode mode)
+{
+   fInterpolation = mode;
+   SpectrumSummary *summary = fSummary.load(memory_order_acquire);
+   if (!summary) return; // tables are made by SetSummary()
+   summary->SetInterpolation(mode);
+   if (fGrid) fGrid->SetInterpolation(mode);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::SetStorage(SpectrumGrid::EStorage storage)
+{
+   fStorage = storage;
+   // a grid without summary is still being filled, see SetSummary()
+   SpectrumSummary *summary = fSummary.load(memory_order_acquire);
+   if (!fGrid || !summary || storage==fGrid->Storage()) return;
+   fGrid->SetStorage(storage);
+   summary->Refill();
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::TMin() const
+{
+   return fGrid ? fGrid->TimeAxis().Min() : 0;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::TMax() const
+{
+   return fGrid ? fGrid->TimeAxis().Max() : 0;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::EMin() const
+{
+   if (fGrid) return fGrid->EnergyAxis().Min();
+   const SpectrumSummary *summary = Summary();
+   return summary ? summary->NeAxis().Min() : 0;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::EMax() const
+{
+   if (fGrid) return fGrid->EnergyAxis().Max();
+   const SpectrumSummary *summary = Summary();
+   return summary ? summary->NeAxis().Max() : 0;
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::N2(unsigned short type, double time,
+      double energy) const
+{
+   return Dispatch(type, [&](auto t) {
+         return N2<decltype(t)::value>(time, energy); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::L2(unsigned short type, double time,
+      double energy) const
+{
+   return Dispatch(type, [&](auto t) {
+         return L2<decltype(t)::value>(time, energy); });
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::N2(unsigned short type, const double *time,
+      const double *energy, double *result, size_t n) const
+{
+   if (!IsValid(type)) { fill(result, result+n, 0.); return; }
+   Dispatch(type, [&](auto t) {
+         N2<decltype(t)::value>(time, energy, result, n); return 0.; });
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumModel::L2(unsigned short type, const double *time,
+      const double *energy, double *result, size_t n) const
+{
+   if (!IsValid(type)) { fill(result, result+n, 0.); return; }
+   Dispatch(type, [&](auto t) {
+         L2<decltype(t)::value>(time, energy, result, n); return 0.; });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::Nt(unsigned short type, double time,
+      double emax) const
+{
+   return Dispatch(type, [&](auto t) {
+         return Nt<decltype(t)::value>(time, emax); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::Ne(unsigned short type, double energy,
+      double tmax) const
+{
+   return Dispatch(type, [&](auto t) {
+         return Ne<decltype(t)::value>(energy, tmax); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::Nall(unsigned short type) const
+{
+   return Dispatch(type, [&](auto t) { return Nall<decltype(t)::value>(); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::Lall(unsigned short type) const
+{
+   return Dispatch(type, [&](auto t) { return Lall<decltype(t)::value>(); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::Eave(unsigned short type) const
+{
+   return Dispatch(type, [&](auto t) { return Eave<decltype(t)::value>(); });
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumModel::NeFD(unsigned short type, double energy) const
+{
+   return Dispatch(type, [&](auto t) {
+         return NeFD<decltype(t)::value>(energy); });
+}
+
+//______________________________________________________________________________
+//
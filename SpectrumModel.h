@@ -0,0 +1,250 @@
+#ifndef SPECTRUMMODEL_H
+#define SPECTRUMMODEL_H
+
+#include "SpectrumSummary.h"
+
+#include <cmath>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+
+namespace NEUS { class SpectrumModel; }
+
+/**
+ * Numerical core of a model: N(t, E) and L(t, E) in a SpectrumGrid, their
+ * integrals and totals in a SpectrumSummary, and all point queries on them.
+ * SupernovaModel keeps one and adds histograms, functions and the ROOT I/O
+ * on top of it. On its own, it loads the binary files written by
+ * NakazatoModel::SaveBinaryData() and LivermoreModel, so that programs
+ * that only compute spectra can link libNEUSCore.so instead of ROOT.
+ *
+ * Queries are const and can be called from many threads at the same time.
+ * They take the types of neutrinos of SupernovaModel; other types, or a
+ * model without data, give 0. Each of them also exists as a template of the
+ * type, e.g. N2<2>(time, energy), for loops that know it when they are
+ * compiled: the type is checked and mapped to its flavor by the compiler.
+ * The queries taking the type as an argument dispatch to those, so both
+ * give identical results. This class does not depend on ROOT.
+ */
+class NEUS::SpectrumModel
+{
+   private:
+      SpectrumGrid *fGrid;
+      /**
+       * Published by SetSummary() after its tables are made, so that
+       * readers never see one being filled.
+       */
+      std::atomic<SpectrumSummary*> fSummary;
+      Interpolator::EMode fInterpolation;
+      SpectrumGrid::EStorage fStorage;
+      std::string fError;
+
+      static bool IsValid(unsigned short type) { return type>=1 && type<=6; }
+      /**
+       * Return f(t), where t is an std::integral_constant of type, with
+       * types 4, 5 and 6 given as 3, their flavor being the same. 0 is
+       * returned for other types.
+       */
+      template<typename F> static double Dispatch(unsigned short type, F f)
+      {
+         switch (type) {
+            case 1: return f(std::integral_constant<unsigned short, 1>());
+            case 2: return f(std::integral_constant<unsigned short, 2>());
+            case 3: case 4: case 5: case 6:
+               return f(std::integral_constant<unsigned short, 3>());
+            default: return 0;
+         }
+      }
+
+      SpectrumModel(const SpectrumModel&);
+      SpectrumModel& operator=(const SpectrumModel&);
+
+   public:
+      /**
+       * Source of N(E) in Ne(): the loaded data, or the Fermi-Dirac
+       * approximation made of Nall() and Eave(), see NeFD().
+       */
+      enum ESource { kTabulated=0, kFermiDirac };
+
+      /**
+       * Flavor of a type, see SpectrumGrid::Flavor(), as a compile-time
+       * constant. Types other than 1 to 6 do not compile.
+       */
+      template<unsigned short type> struct Flavor
+      {
+         static_assert(type>=1 && type<=6,
+               "Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+         static const unsigned short value = type<3 ? type-1 : 2;
+      };
+
+      SpectrumModel();
+      ~SpectrumModel() { Clear(); }
+
+      /**
+       * Delete the grid and the summary. The interpolation is kept.
+       */
+      void Clear();
+
+      /**
+       * Largest difference, in seconds, between the end of a grid and that
+       * of a time integration for them to be taken as the same. Times in
+       * the ASCII files of the Nakazato database have 7 significant digits,
+       * i.e. 1e-5 s around 20 s, and the end of a grid is half a bin after
+       * the last of them, so it is off by up to 1.5e-5 s.
+       */
+      static const double fgEndTolerance;
+
+      /**
+       * Load a binary file, see GridFile. The grid is mapped without being
+       * copied. Time-integrated N(E) and L(E) in the file are used for
+       * Ne() and totals if there is no grid, as for the black hole, or if
+       * the grid ends at tmax, the end of their time integration, within
+       * fgEndTolerance, e.g. 20.125 s for Nakazato models. False is
+       * returned if the file cannot be used, see Error().
+       */
+      bool Load(const char *path, double tmax=0);
+      const char* Error() const { return fError.c_str(); }
+
+      /**
+       * Use grid, which is deleted with the model. The summary is dropped
+       * and has to be set again once the grid is filled.
+       */
+      void SetGrid(SpectrumGrid *grid);
+      SpectrumGrid* Grid() { return fGrid; }
+      const SpectrumGrid* Grid() const { return fGrid; }
+      /**
+       * Make interpolation tables of summary and of the grid, convert the
+       * grid to Storage(), then use summary, which is deleted with the
+       * model. It must be called whenever the grid is changed, and not
+       * while other threads query the model.
+       */
+      void SetSummary(SpectrumSummary *summary);
+      /**
+       * NULL until SetSummary() or Load() is called.
+       */
+      const SpectrumSummary* Summary() const
+      { return fSummary.load(std::memory_order_acquire); }
+
+      /**
+       * See SupernovaModel::SetInterpolation(). It must not be called
+       * while other threads query the model.
+       */
+      void SetInterpolation(Interpolator::EMode mode);
+      Interpolator::EMode Interpolation() const { return fInterpolation; }
+      /**
+       * Storage of the grid, see SpectrumGrid::SetStorage(). Integrals and
+       * totals are made again from the converted contents, so that they
+       * agree with N2() and L2(). A mapped grid is copied into its own
+       * storage. It must not be called while other threads query the
+       * model.
+       */
+      void SetStorage(SpectrumGrid::EStorage storage);
+      SpectrumGrid::EStorage Storage() const { return fStorage; }
+
+      /**
+       * Ranges of the grid, or those of N(E) without a grid, in which case
+       * the time range is empty.
+       */
+      double TMin() const;
+      double TMax() const;
+      double EMin() const;
+      double EMax() const;
+
+      /**
+       * Same as those of SupernovaModel.
+       */
+      double N2(unsigned short type, double time, double energy) const;
+      double L2(unsigned short type, double time, double energy) const;
+      void N2(unsigned short type, const double *time, const double *energy,
+            double *result, std::size_t n) const;
+      void L2(unsigned short type, const double *time, const double *energy,
+            double *result, std::size_t n) const;
+      double Nt(unsigned short type, double time, double emax=999.) const;
+      double Ne(unsigned short type, double energy, double tmax=999.) const;
+      double Nall(unsigned short type) const;
+      double Lall(unsigned short type) const;
+      double Eave(unsigned short type) const;
+      /**
+       * Fermi-Dirac approximation of N(E), in unit of 1e50/MeV, with the
+       * total number and the average energy of the data.
+       */
+      double NeFD(unsigned short type, double energy) const;
+
+      template<unsigned short type>
+      double N2(double time, double energy) const
+      {
+         if (!fGrid) return 0;
+         return fGrid->Interpolate(SpectrumGrid::kNumber,
+               Flavor<type>::value, time, energy);
+      }
+      template<unsigned short type>
+      double L2(double time, double energy) const
+      {
+         if (!fGrid) return 0;
+         return fGrid->Interpolate(SpectrumGrid::kLuminosity,
+               Flavor<type>::value, time, energy);
+      }
+      template<unsigned short type>
+      void N2(const double *time, const double *energy, double *result,
+            std::size_t n) const
+      {
+         if (!fGrid) { std::fill(result, result+n, 0.); return; }
+         fGrid->Interpolate(SpectrumGrid::kNumber, Flavor<type>::value,
+               time, energy, result, n);
+      }
+      template<unsigned short type>
+      void L2(const double *time, const double *energy, double *result,
+            std::size_t n) const
+      {
+         if (!fGrid) { std::fill(result, result+n, 0.); return; }
+         fGrid->Interpolate(SpectrumGrid::kLuminosity, Flavor<type>::value,
+               time, energy, result, n);
+      }
+      template<unsigned short type>
+      double Nt(double time, double emax=999.) const
+      {
+         const SpectrumSummary *summary = Summary();
+         if (!summary) return 0;
+         if (emax>=summary->EnergyAxis().Max())
+            return summary->Nt(Flavor<type>::value, time);
+         return summary->Nt(Flavor<type>::value, time, emax);
+      }
+      /**
+       * N(E) from source, chosen by the compiler.
+       */
+      template<unsigned short type, ESource source=kTabulated>
+      double Ne(double energy, double tmax=999.) const
+      {
+         if (source==kFermiDirac) return NeFD<type>(energy);
+         const SpectrumSummary *summary = Summary();
+         if (!summary) return 0;
+         if (tmax>=summary->TimeAxis().Max())
+            return summary->Ne(Flavor<type>::value, energy);
+         return summary->Ne(Flavor<type>::value, energy, tmax);
+      }
+      template<unsigned short type> double Nall() const
+      {
+         const SpectrumSummary *summary = Summary();
+         return summary ? summary->TotalN(Flavor<type>::value) : 0;
+      }
+      template<unsigned short type> double Lall() const
+      {
+         const SpectrumSummary *summary = Summary();
+         return summary ? summary->TotalL(Flavor<type>::value) : 0;
+      }
+      template<unsigned short type> double Eave() const
+      {
+         const SpectrumSummary *summary = Summary();
+         return summary ? summary->AverageE(Flavor<type>::value) : 0;
+      }
+      template<unsigned short type> double NeFD(double energy) const
+      {
+         double co = 0.55 * Nall<type>(); // coefficient
+         double kT = Eave<type>()*2/6.; // <E> = NDF*kT/2 => kT = <E>*2/NDF
+         return co/kT/kT/kT * energy*energy/(1.+std::exp(energy/kT));
+      }
+};
+
+#endif
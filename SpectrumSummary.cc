@@ -0,0 +1,308 @@
+#include "SpectrumSummary.h"
+using namespace std;
+
+namespace {
+   // Linear interpolation of value(i) between bin centers, with the values
+   // of the outermost bins outside of them, as TH1::Interpolate does, and
+   // 0 for NaN.
+   template<class Value>
+   double InterpolateTH1(const NEUS::GridAxis &axis, const Value &value,
+         double x)
+   {
+      const unsigned short n = axis.GetNbins();
+      const double *c = axis.Centers();
+      if (x<=c[0]) return value(0);
+      if (x>=c[n-1]) return value(n-1);
+      int i;
+      double w;
+      if (!axis.Locate(x, i, w)) return 0; // NaN, as Interpolator does
+      // same arithmetic as TH1::Interpolate
+      double y0 = value(i), y1 = value(i+1);
+      return y0 + (x-c[i])*((y1-y0)/(c[i+1]-c[i]));
+   }
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::SpectrumSummary::SpectrumSummary() : fGrid(0), fTaxis(), fEaxis(),
+   fNeAxis(), fNe(), fLe(), fNt(), fIntegrated(false),
+   fMode(Interpolator::kLinear), fMissing(0), fMutex()
+{
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      fTotalN[f] = fTotalL[f] = fAverageE[f] = 0;
+      fFixedN[f] = fFixedE[f] = false;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumSummary::Interpolate(const GridAxis &axis,
+      const double *row, double x)
+{
+   return InterpolateTH1(axis, [row](int i) { return row[i]; }, x);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::Fill(const SpectrumGrid &grid)
+{
+   if (grid.IsEmpty()) return;
+   SetInterpolation(Interpolator::kLinear); // tables of old rows
+   const unsigned short nt = grid.TBins(), ne = grid.EBins();
+   fGrid = &grid;
+   fTaxis.Set(nt, grid.TimeAxis().Edges());
+   fEaxis.Set(ne, grid.EnergyAxis().Edges());
+   fNeAxis.Set(ne, grid.EnergyAxis().Edges());
+   fNe.assign(fgNflavor*ne, 0.);
+   fLe.assign(fgNflavor*ne, 0.);
+   fNt.assign(fgNflavor*nt, 0.);
+   fIntegrated = false;
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      fCumT[f].clear();
+      fCumE[f].clear();
+      fTotalN[f] = fTotalL[f] = fAverageE[f] = 0;
+      fFixedN[f] = fFixedE[f] = false;
+   }
+   fMissing.store((1u<<fgNflavor)-1, memory_order_release);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::Refill()
+{
+   if (!HasGrid()) return;
+   lock_guard<mutex> lock(fMutex);
+   fMissing.store((1u<<fgNflavor)-1, memory_order_release);
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      fCumT[f].clear();
+      fCumE[f].clear();
+      if (fIntegrated) SetNtInterpolation(f, false);
+      else SetInterpolation(f, false);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::Make(unsigned short f) const
+{
+   lock_guard<mutex> lock(fMutex);
+   if (IsMade(f)) return; // by another thread
+   // making sums does not change what the summary represents
+   SpectrumSummary *self = const_cast<SpectrumSummary*>(this);
+   const SpectrumGrid &grid = *fGrid;
+   const unsigned short nt = grid.TBins(), ne = grid.EBins();
+   self->fCumT[f].assign(2*(nt+1u)*ne, 0.);
+   self->fCumE[f].assign(3*nt*(ne+1u), 0.);
+
+   vector<double> bufferN, bufferL;
+   const double *n = grid.Content(SpectrumGrid::kNumber, f, bufferN);
+   for (unsigned short q=kNumber; q<=kLuminosity; q++) {
+      // L derived from N is weighted here rather than widened
+      const double *w = q==kLuminosity ? grid.LuminosityWeights() : 0;
+      const double *c = q==kNumber || w ? n
+         : grid.Content(SpectrumGrid::kLuminosity, f, bufferL);
+      // row k+1 adds time bin k to row k
+      double *cumT = self->CumT(q, f);
+      for (unsigned short it=0; it<nt; it++)
+         for (unsigned short ie=0; ie<ne; ie++)
+            cumT[(it+1)*ne+ie] = cumT[it*ne+ie]
+               + (w ? c[it*ne+ie]*w[ie] : c[it*ne+ie]) * fTaxis.BinWidth(it);
+      // column k+1 adds energy bin k to column k
+      double *cumE = self->CumE(q, f);
+      for (unsigned short it=0; it<nt; it++)
+         for (unsigned short ie=0; ie<ne; ie++)
+            cumE[it*(ne+1)+ie+1] = cumE[it*(ne+1)+ie]
+               + (w ? c[it*ne+ie]*w[ie] : c[it*ne+ie]) * fEaxis.BinWidth(ie);
+   }
+   double *cumNE = self->CumE(kEnergy, f);
+   for (unsigned short it=0; it<nt; it++)
+      for (unsigned short ie=0; ie<ne; ie++)
+         cumNE[it*(ne+1)+ie+1] = cumNE[it*(ne+1)+ie]
+            + n[it*ne+ie] * fEaxis.BinWidth(ie) * fEaxis.Centers()[ie];
+
+   // full ranges, unless they are given by SetIntegrated()
+   if (!fIntegrated) {
+      for (unsigned short ie=0; ie<ne; ie++) {
+         self->fNe[f*ne+ie] = CumT(kNumber, f)[nt*ne+ie];
+         self->fLe[f*ne+ie] = CumT(kLuminosity, f)[nt*ne+ie];
+      }
+      self->ComputeTotals(f);
+   }
+   for (unsigned short it=0; it<nt; it++)
+      self->fNt[f*nt+it] = CumE(kNumber, f)[it*(ne+1)+ne];
+   // tables of SetIntegrated() are read by Ne() and Le() without lock
+   if (fIntegrated) self->SetNtInterpolation(f, true);
+   else self->SetInterpolation(f, true);
+   fMissing.fetch_and(~(1u<<f), memory_order_release);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::SetIntegrated(unsigned short nbinsE,
+      const double *edges, const double *data)
+{
+   SetInterpolation(Interpolator::kLinear); // tables of old rows
+   fNeAxis.Set(nbinsE, edges);
+   fNe.assign(data, data+fgNflavor*nbinsE);
+   fLe.assign(data+fgNflavor*nbinsE, data+2*fgNflavor*nbinsE);
+   fIntegrated = true;
+   for (unsigned short f=0; f<fgNflavor; f++) {
+      fFixedN[f] = fFixedE[f] = false;
+      ComputeTotals(f);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::ComputeTotals(unsigned short f)
+{
+   const unsigned short ne = fNeAxis.GetNbins();
+   double n=0, l=0;
+   for (unsigned short ie=0; ie<ne; ie++) {
+      n += fNe[f*ne+ie] * fNeAxis.BinWidth(ie);
+      l += fLe[f*ne+ie] * fNeAxis.BinWidth(ie);
+   }
+   if (!fFixedN[f]) fTotalN[f] = n;
+   fTotalL[f] = l;
+   if (!fFixedE[f]) fAverageE[f] = n>0 ? l/n/1.60217646e-6 : 0;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::IntegrateT(EQuantity q, unsigned short flavor,
+      double tmax, double *result) const
+{
+   Require(flavor);
+   const unsigned short ne = fEaxis.GetNbins();
+   unsigned short k;
+   double frac;
+   fTaxis.Cut(tmax, k, frac);
+   const double *row = CumT(q, flavor) + k*ne;
+   for (unsigned short ie=0; ie<ne; ie++) result[ie] = row[ie];
+   if (frac>0)
+      for (unsigned short ie=0; ie<ne; ie++)
+         result[ie] += (row[ne+ie]-row[ie])*frac;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::IntegrateE(EQuantity q, unsigned short flavor,
+      double emax, double *result) const
+{
+   Require(flavor);
+   const unsigned short nt = fTaxis.GetNbins(), ne = fEaxis.GetNbins();
+   unsigned short k;
+   double frac;
+   fEaxis.Cut(emax, k, frac);
+   const double *cum = CumE(q, flavor) + k;
+   for (unsigned short it=0; it<nt; it++) result[it] = cum[it*(ne+1)];
+   if (frac==0) return;
+
+   // N is constant in a bin, so the N*E integral over its part [e, emax]
+   // is N*(emax^2-e^2)/2
+   const double e = fEaxis.Edges()[k];
+   const double *bin = q==kEnergy ? CumE(kNumber, flavor) + k : cum;
+   const double scale = q==kEnergy ? frac*(emax+e)/2 : frac;
+   for (unsigned short it=0; it<nt; it++)
+      result[it] += (bin[it*(ne+1)+1]-bin[it*(ne+1)])*scale;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::AverageE(unsigned short flavor, double emax,
+      double *result) const
+{
+   const unsigned short nt = fTaxis.GetNbins();
+   vector<double> n(nt);
+   IntegrateE(kNumber, flavor, emax, &n[0]);
+   IntegrateE(kEnergy, flavor, emax, result);
+   for (unsigned short it=0; it<nt; it++) result[it] /= n[it];
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::SetInterpolation(Interpolator::EMode mode)
+{
+   lock_guard<mutex> lock(fMutex);
+   fMode = mode;
+   // flavors not made yet get tables in Make()
+   for (unsigned short f=0; f<fgNflavor; f++) SetInterpolation(f, IsMade(f));
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::SetInterpolation(unsigned short f, bool made)
+{
+   fNeInterpolators[f].Clear();
+   fLeInterpolators[f].Clear();
+   if (HasNe() && (fIntegrated || made)) {
+      fNeInterpolators[f].Set(fMode, fNeAxis, 0, &fNe[f*fNeAxis.GetNbins()]);
+      fLeInterpolators[f].Set(fMode, fNeAxis, 0, &fLe[f*fNeAxis.GetNbins()]);
+   }
+   SetNtInterpolation(f, made);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SpectrumSummary::SetNtInterpolation(unsigned short f, bool made)
+{
+   fNtInterpolators[f].Clear();
+   if (HasGrid() && made)
+      fNtInterpolators[f].Set(fMode, fTaxis, 0, &fNt[f*fTaxis.GetNbins()]);
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumSummary::Ne(unsigned short flavor, double energy,
+      double tmax) const
+{
+   if (!HasGrid() || tmax>=fTaxis.Max()) return Ne(flavor, energy);
+   Require(flavor);
+   const unsigned short ne = fEaxis.GetNbins();
+   unsigned short k;
+   double frac;
+   fTaxis.Cut(tmax, k, frac);
+   const double *row = CumT(kNumber, flavor) + k*ne;
+   return InterpolateTH1(fEaxis, [row, ne, frac](int ie) {
+         return frac>0 ? row[ie] + (row[ne+ie]-row[ie])*frac : row[ie]; },
+         energy);
+}
+
+//______________________________________________________________________________
+//
+
+double NEUS::SpectrumSummary::Nt(unsigned short flavor, double time,
+      double emax) const
+{
+   if (!HasGrid()) return 0;
+   Require(flavor);
+   if (emax>=fEaxis.Max()
+         && fNtInterpolators[flavor].Mode()!=Interpolator::kLinear)
+      return Nt(flavor, time);
+   const unsigned short ne = fEaxis.GetNbins();
+   unsigned short k;
+   double frac;
+   fEaxis.Cut(emax, k, frac);
+   const double *cum = CumE(kNumber, flavor) + k;
+   return InterpolateTH1(fTaxis, [cum, ne, frac](int it) {
+         const double *c = cum + it*(ne+1);
+         return frac>0 ? c[0] + (c[1]-c[0])*frac : c[0]; },
+         time);
+}
+
+//______________________________________________________________________________
+//
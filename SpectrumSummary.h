@@ -0,0 +1,260 @@
+#ifndef SPECTRUMSUMMARY_H
+#define SPECTRUMSUMMARY_H
+
+#include "SpectrumGrid.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+namespace NEUS { class SpectrumSummary; }
+
+/**
+ * Spectra integrated over time or energy and their totals.
+ * N(E) and L(E) are integrated over all time bins, N(t) over all energy
+ * bins, and the total number, luminosity and average energy of each flavor
+ * over both. Cumulative sums of the grid along time and along energy are
+ * kept as well, so that integrals up to any cutoff take constant time per
+ * bin. Sums of a flavor are made from the grid the first time something of
+ * that flavor is requested, under a lock taken once per flavor, so that a
+ * summary can be shared by many threads and only flavors in use cost time
+ * and memory. This class does not depend on ROOT.
+ */
+class NEUS::SpectrumSummary
+{
+   public:
+      /**
+       * Quantities integrated over energy.
+       * kNumber and kLuminosity are those in SpectrumGrid, kEnergy is
+       * the number of neutrinos weighted by their energy.
+       */
+      enum EQuantity { kNumber=SpectrumGrid::kNumber,
+         kLuminosity=SpectrumGrid::kLuminosity, kEnergy=2 };
+
+   private:
+      static const unsigned short fgNflavor = SpectrumGrid::fgNflavor;
+
+      const SpectrumGrid *fGrid; // of Fill(), NULL if there is none
+      GridAxis fTaxis, fEaxis; // of the grid
+      GridAxis fNeAxis; // of fNe and fLe
+      std::vector<double> fNe, fLe; // fgNflavor rows of fNeAxis.GetNbins()
+      std::vector<double> fNt; // fgNflavor rows of fTaxis.GetNbins()
+      bool fIntegrated; // fNe and fLe are given by SetIntegrated()
+
+      /**
+       * Integrals of N and L of a flavor over the first k time bins, k from
+       * 0 to nT. There are 2 blocks of nT+1 rows of nE values.
+       */
+      std::vector<double> fCumT[fgNflavor];
+      /**
+       * Integrals of N, L and N*E of a flavor over the first k energy bins,
+       * k from 0 to nE. There are 3 blocks of nT rows of nE+1 values.
+       */
+      std::vector<double> fCumE[fgNflavor];
+
+      double fTotalN[fgNflavor], fTotalL[fgNflavor], fAverageE[fgNflavor];
+      bool fFixedN[fgNflavor], fFixedE[fgNflavor]; // by SetTotalN() ...
+
+      /**
+       * Tables of SetInterpolation() for fNe, fLe and fNt.
+       */
+      Interpolator fNeInterpolators[fgNflavor], fLeInterpolators[fgNflavor];
+      Interpolator fNtInterpolators[fgNflavor];
+      Interpolator::EMode fMode; // of SetInterpolation()
+
+      /**
+       * Bit f is set while sums of flavor f are not made yet. It is
+       * cleared after they are made, so that a reader seeing it cleared
+       * sees them.
+       */
+      mutable std::atomic<unsigned int> fMissing;
+      mutable std::mutex fMutex; // serializes Make()
+
+      double* CumT(unsigned short q, unsigned short flavor)
+      { return &fCumT[flavor][q*(fTaxis.GetNbins()+1u)*fEaxis.GetNbins()]; }
+      const double* CumT(unsigned short q, unsigned short flavor) const
+      { return &fCumT[flavor][q*(fTaxis.GetNbins()+1u)*fEaxis.GetNbins()]; }
+      double* CumE(unsigned short q, unsigned short flavor)
+      { return &fCumE[flavor][q*fTaxis.GetNbins()*(fEaxis.GetNbins()+1u)]; }
+      const double* CumE(unsigned short q, unsigned short flavor) const
+      { return &fCumE[flavor][q*fTaxis.GetNbins()*(fEaxis.GetNbins()+1u)]; }
+
+      /**
+       * Make sums of flavor from the grid if they are not made yet.
+       */
+      void Require(unsigned short flavor) const
+      {
+         if (fMissing.load(std::memory_order_acquire) & (1u<<flavor))
+            Make(flavor);
+      }
+      void Make(unsigned short flavor) const;
+
+      /**
+       * Integrate N(E) and L(E) of flavor over energy.
+       */
+      void ComputeTotals(unsigned short flavor);
+      /**
+       * Interpolation tables of flavor in fMode, those of the grid only if
+       * its sums are made.
+       */
+      void SetInterpolation(unsigned short flavor, bool made);
+      /**
+       * Table of fNt only, which leaves those of fNe and fLe given by
+       * SetIntegrated() alone while other threads read them.
+       */
+      void SetNtInterpolation(unsigned short flavor, bool made);
+      /**
+       * Linear interpolation between bin centers of a row, with the values
+       * of the outermost bins outside of them, as TH1::Interpolate does.
+       * 0 is returned if x is NaN.
+       */
+      static double Interpolate(const GridAxis &axis, const double *row,
+            double x);
+
+      SpectrumSummary(const SpectrumSummary&);
+      SpectrumSummary& operator=(const SpectrumSummary&);
+
+   public:
+      SpectrumSummary();
+
+      /**
+       * Integrate N(t, E) and L(t, E) in grid, flavor by flavor the first
+       * time they are needed. grid must outlive the summary and must not
+       * be changed afterwards, except by SpectrumGrid::SetStorage(), which
+       * changes sums not made yet.
+       * The sums run in the same order as those in SupernovaModel::HNe()
+       * and HNt() used to, so the full-range results are bit-identical.
+       */
+      void Fill(const SpectrumGrid &grid);
+      /**
+       * Make sums again from the grid of Fill() when they are needed, e.g.
+       * after its storage is changed. Values given by SetIntegrated(),
+       * SetTotalN() and SetAverageE() are kept.
+       */
+      void Refill();
+      /**
+       * Use N(E) and L(E) integrated elsewhere, e.g. provided by a database.
+       * data holds 6*nbinsE values: N(E) of v_e, anti-v_e and v_x, followed
+       * by L(E) of them. Totals are updated. Cumulative sums are not.
+       */
+      void SetIntegrated(unsigned short nbinsE, const double *edges,
+            const double *data);
+      /**
+       * Overwrite totals, e.g. by values given in a paper.
+       */
+      void SetTotalN(unsigned short flavor, double n)
+      { fTotalN[flavor]=n; fFixedN[flavor]=true; }
+      void SetAverageE(unsigned short flavor, double e)
+      { fAverageE[flavor]=e; fFixedE[flavor]=true; }
+
+      bool HasNe() const { return !fNe.empty(); }
+      bool HasGrid() const { return fGrid!=0; }
+      /**
+       * Whether sums of flavor are made, see Fill().
+       */
+      bool IsMade(unsigned short flavor) const
+      { return !(fMissing.load(std::memory_order_acquire) & (1u<<flavor)); }
+
+      const GridAxis& TimeAxis() const { return fTaxis; }
+      const GridAxis& EnergyAxis() const { return fEaxis; }
+      const GridAxis& NeAxis() const { return fNeAxis; }
+
+      /**
+       * N(E) (kNumber) or L(E) (kLuminosity) over the full time range in
+       * each bin of NeAxis().
+       */
+      const double* Integrated(EQuantity q, unsigned short flavor) const
+      {
+         if (!fIntegrated) Require(flavor);
+         return &(q==kNumber ? fNe : fLe)[flavor*fNeAxis.GetNbins()];
+      }
+
+      /**
+       * Interpolate Ne(), Le() and Nt() over the full ranges with mode
+       * from now on, see Interpolator. It has to be called after Fill()
+       * and SetIntegrated(). Integrals up to cutoffs are interpolated
+       * linearly.
+       */
+      void SetInterpolation(Interpolator::EMode mode);
+
+      double Ne(unsigned short flavor, double energy) const
+      {
+         if (!HasNe()) return 0;
+         if (!fIntegrated) Require(flavor);
+         if (fNeInterpolators[flavor].Mode()!=Interpolator::kLinear)
+            return fNeInterpolators[flavor].Evaluate(energy);
+         return Interpolate(fNeAxis, &fNe[flavor*fNeAxis.GetNbins()], energy);
+      }
+      double Le(unsigned short flavor, double energy) const
+      {
+         if (!HasNe()) return 0;
+         if (!fIntegrated) Require(flavor);
+         if (fLeInterpolators[flavor].Mode()!=Interpolator::kLinear)
+            return fLeInterpolators[flavor].Evaluate(energy);
+         return Interpolate(fNeAxis, &fLe[flavor*fNeAxis.GetNbins()], energy);
+      }
+      double Nt(unsigned short flavor, double time) const
+      {
+         if (!HasGrid()) return 0;
+         Require(flavor);
+         if (fNtInterpolators[flavor].Mode()!=Interpolator::kLinear)
+            return fNtInterpolators[flavor].Evaluate(time);
+         return Interpolate(fTaxis, &fNt[flavor*fTaxis.GetNbins()], time);
+      }
+      /**
+       * N(E) integrated over [TimeAxis().Min(), tmax], interpolated at
+       * energy like Ne(). Bins of the time axis are cut exactly at tmax.
+       */
+      double Ne(unsigned short flavor, double energy, double tmax) const;
+      /**
+       * N(t) integrated over [EnergyAxis().Min(), emax], interpolated at
+       * time like Nt(). Bins of the energy axis are cut exactly at emax.
+       */
+      double Nt(unsigned short flavor, double time, double emax) const;
+
+      /**
+       * Integral of N (kNumber) or L (kLuminosity) over
+       * [TimeAxis().Min(), tmax] in each energy bin, saved in result,
+       * which must hold EnergyAxis().GetNbins() values.
+       */
+      void IntegrateT(EQuantity q, unsigned short flavor, double tmax,
+            double *result) const;
+      /**
+       * Integrals of N (kNumber) or L (kLuminosity) of flavor over the first
+       * k time bins, k from 0 to TimeAxis().GetNbins(), in rows of
+       * EnergyAxis().GetNbins() values, which IntegrateT() cuts. Sums are
+       * made if they are not yet. Refill() invalidates them. HasGrid() must
+       * be true.
+       */
+      const double* CumulativeT(EQuantity q, unsigned short flavor) const
+      { Require(flavor); return CumT(q, flavor); }
+      /**
+       * Integral of N, L or N*E (kEnergy) over [EnergyAxis().Min(), emax]
+       * in each time bin, saved in result, which must hold
+       * TimeAxis().GetNbins() values.
+       */
+      void IntegrateE(EQuantity q, unsigned short flavor, double emax,
+            double *result) const;
+      /**
+       * Average energy in [EnergyAxis().Min(), emax] in each time bin.
+       */
+      void AverageE(unsigned short flavor, double emax, double *result) const;
+
+      double TotalN(unsigned short flavor) const
+      {
+         if (!fIntegrated && !fFixedN[flavor]) Require(flavor);
+         return fTotalN[flavor];
+      }
+      double TotalL(unsigned short flavor) const
+      { if (!fIntegrated) Require(flavor); return fTotalL[flavor]; }
+      /**
+       * TotalL()/TotalN() in MeV.
+       */
+      double AverageE(unsigned short flavor) const
+      {
+         if (!fIntegrated && !fFixedE[flavor]) Require(flavor);
+         return fAverageE[flavor];
+      }
+};
+
+#endif
@@ -1,29 +1,34 @@
 #include "SupernovaModel.h"
+#include "SpectrumGrid.h"
+#include "SpectrumSummary.h"
 
 #include <TF1.h>
 #include <TH2D.h>
 #include <TAxis.h>
 
 #include <cmath>
+#include <mutex>
+#include <vector>
+#include <algorithm>
 using namespace std;
 
+namespace {
+   // serializes Finalize() called by const queries of models read from files
+   mutex gFinalizeMutex;
+}
+
 //______________________________________________________________________________
 //
 
 NEUS::SupernovaModel::SupernovaModel() : TNamed(), fDataLocation(),
-   fMinE(0), fMaxE(0), fMinT(0), fMaxT(0)
+   fMinE(0), fMaxE(0), fMinT(0), fMaxT(0), fCache()
 {
    for (UShort_t i=0; i<fgNtype; i++) {
       fTotalN[i] = 0;
       fTotalL[i] = 0;
-      fAverageE[i] = 1.0; // 0 cannot be in the denominator
+      fAverageE[i] = 0;
       fHN2[i] = 0;
       fHL2[i] = 0;
-      fHNe[i] = 0;
-      fHNt[i] = 0;
-      fHLe[i] = 0;
-      fHLt[i] = 0;
-      fHEt[i] = 0;
       fNeFD[i]= 0;
    }
 }
@@ -37,14 +42,9 @@ NEUS::SupernovaModel::SupernovaModel(const char *name, const char *title) :
    for (UShort_t i=0; i<fgNtype; i++) {
       fTotalN[i] = 0;
       fTotalL[i] = 0;
-      fAverageE[i] = 1.0;
+      fAverageE[i] = 0;
       fHN2[i] = 0;
       fHL2[i] = 0;
-      fHNe[i] = 0;
-      fHNt[i] = 0;
-      fHLe[i] = 0;
-      fHLt[i] = 0;
-      fHEt[i] = 0;
       fNeFD[i]= 0;
    }
 }
@@ -54,37 +54,38 @@ NEUS::SupernovaModel::SupernovaModel(const char *name, const char *title) :
 
 void NEUS::SupernovaModel::Clear(Option_t *option)
 {
+   // types may share histograms, delete each of them once
+   for (UShort_t i=1; i<fgNtype; i++) {
+      for (UShort_t j=0; j<i; j++) {
+         if (fHN2[i]==fHN2[j]) fHN2[i] = 0;
+         if (fHL2[i]==fHL2[j]) fHL2[i] = 0;
+      }
+   }
    for (UShort_t i=0; i<fgNtype; i++) {
       fTotalN[i] = 0;
       fTotalL[i] = 0;
-      fAverageE[i] = 1.; // 0 cannot be in the denominator
+      fAverageE[i] = 0;
       if (fNeFD[i]) delete fNeFD[i];
       if (fHN2[i]) delete fHN2[i];
       if (fHL2[i]) delete fHL2[i];
-      if (fHNe[i]) delete fHNe[i];
-      if (fHNt[i]) delete fHNt[i];
-      if (fHLe[i]) delete fHLe[i];
-      if (fHLt[i]) delete fHLt[i];
-      if (fHEt[i]) delete fHEt[i];
       fHN2[i] = 0;
       fHL2[i] = 0;
-      fHNe[i] = 0;
-      fHNt[i] = 0;
-      fHLe[i] = 0;
-      fHLt[i] = 0;
-      fHEt[i] = 0;
       fNeFD[i] = 0;
    }
+   fCache.Clear();
+   fCore.Clear();
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::NeFD(UShort_t type, Double_t energy)
+Double_t NEUS::SupernovaModel::NeFD(UShort_t type, Double_t energy) const
 {
-   Double_t co = 0.55 * Nall(type); // coefficient
-   Double_t kT = Eave(type)*2/6.; // <E> = NDF*kT/2 => kT = <E>*2/NDF
-   return co/kT/kT/kT * energy*energy/(1.+exp(energy/kT));
+   if (type<1 || type>6) {
+      Warning("NeFD","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   return Core().NeFD(type, energy);
 }
 
 //______________________________________________________________________________
@@ -155,6 +156,7 @@ TH2D* NEUS::SupernovaModel::HN2(UShort_t type)
       Warning("HN2","NULL pointer is returned!");
       return 0;
    }
+   if (!fHN2[type] && fCore.Grid()) CreateHistograms();
    if (!fHN2[type]) {
       Warning("HN2","Spectrum does not exist!");
       Warning("HN2","Is the database correctly loaded?");
@@ -173,6 +175,7 @@ TH2D* NEUS::SupernovaModel::HL2(UShort_t type)
       Warning("HL2","NULL pointer is returned!");
       return 0;
    }
+   if (!fHL2[type] && fCore.Grid()) CreateHistograms();
    if (!fHL2[type]) {
       Warning("HL2","Spectrum does not exist!");
       Warning("HL2","Is the database correctly loaded?");
@@ -184,6 +187,35 @@ TH2D* NEUS::SupernovaModel::HL2(UShort_t type)
 //______________________________________________________________________________
 //
 
+TH1D* NEUS::SupernovaModel::FillHistogram(const HistogramCache::Key &key,
+      const char *name, const char *title, const GridAxis &axis,
+      const Double_t *content)
+{
+   TH1D *h = fCache.Recycle();
+   Bool_t reusable = h && h->GetNbinsX()==axis.GetNbins();
+   for (UShort_t i=0; reusable && i<=axis.GetNbins(); i++)
+      if (h->GetXaxis()->GetBinLowEdge(i+1)!=axis.Edges()[i])
+         reusable = kFALSE;
+
+   if (reusable) {
+      h->SetName(name);
+   } else {
+      if (h) delete h;
+      h = new TH1D(name, "", axis.GetNbins(), axis.Edges());
+      h->SetStats(0);
+   }
+   // a reused histogram may have been another observable or flavor
+   const Color_t color[SpectrumGrid::fgNflavor] = {kBlack, kRed, kBlue};
+   h->SetLineColor(color[key.flavor]);
+   h->SetTitle(TString(GetTitle())+title);
+   for (UShort_t i=0; i<axis.GetNbins(); i++)
+      h->SetBinContent(i+1, content[i]);
+   return fCache.Add(key, h);
+}
+
+//______________________________________________________________________________
+//
+
 TH1D* NEUS::SupernovaModel::HNe(UShort_t type, Double_t tmax)
 {
    if (type<1 || type>6) {
@@ -193,31 +225,28 @@ TH1D* NEUS::SupernovaModel::HNe(UShort_t type, Double_t tmax)
    }
    if (tmax>fMaxT) tmax=fMaxT;
 
-   TString name = Form("hNe-%s-%d-%.4f", GetName(), type, tmax);
-   if (fHNe[type]) {
-      if (name.CompareTo(fHNe[type]->GetName())==0) return fHNe[type];
-      else delete fHNe[type];
-   }
-
-   fHNe[type] = new TH1D(name.Data(),
-         ";energy [MeV];number of neutrinos [10^{50}/MeV]",
-         HN2(type)->GetNbinsY(),
-         HN2(type)->GetYaxis()->GetXbins()->GetArray());
-   fHNe[type]->SetStats(0);
-   fHNe[type]->SetLineColor(HN2(type)->GetLineColor());
-   fHNe[type]->SetTitle(GetTitle());
-
-   // calculate integral in [0, tmax]
-   for (UShort_t iy=1; iy<=HN2(type)->GetNbinsY(); iy++) {
-      Double_t content=0;
-      for (UShort_t ix=1; ix<=HN2(type)->GetNbinsX(); ix++) {
-         if (tmax<HN2(type)->GetXaxis()->GetBinCenter(ix)) break;
-         content += HN2(type)->GetBinContent(ix,iy) *
-            HN2(type)->GetXaxis()->GetBinWidth(ix);
-      }
-      fHNe[type]->SetBinContent(iy,content);
+   UShort_t flavor = SpectrumGrid::Flavor(type);
+   HistogramCache::Key key(HistogramCache::kNe, flavor, tmax);
+   if (TH1D *h = fCache.Find(key)) return h;
+
+   TString name = Form("hNe-%s-%d-%.4f", GetName(), flavor+1, tmax);
+   NEUS_PROFILE_COUNT(fProfiler.Rebuild(Profiler::kHNe));
+   const char *title = ";energy [MeV];number of neutrinos [10^{50}/MeV]";
+   const SpectrumSummary *summary = Summary();
+   // full time range, also for models without N(t, E)
+   if (tmax>=fMaxT && summary->HasNe())
+      return FillHistogram(key, name, title, summary->NeAxis(),
+            summary->Integrated(SpectrumSummary::kNumber, flavor));
+   if (!summary->HasGrid()) {
+      Warning("HNe","Spectrum does not exist!");
+      Warning("HNe","NULL pointer is returned!");
+      return 0;
    }
-   return fHNe[type];
+
+   // integral in [TMin(), tmax]
+   vector<Double_t> content(summary->EnergyAxis().GetNbins());
+   summary->IntegrateT(SpectrumSummary::kNumber, flavor, tmax, &content[0]);
+   return FillHistogram(key, name, title, summary->EnergyAxis(), &content[0]);
 }
 
 //______________________________________________________________________________
@@ -232,31 +261,28 @@ TH1D* NEUS::SupernovaModel::HLe(UShort_t type, Double_t tmax)
    }
    if (tmax>fMaxT) tmax=fMaxT;
 
-   TString name = Form("hLe-%s-%d-%.4f", GetName(), type, tmax);
-   if (fHLe[type]) {
-      if (name.CompareTo(fHLe[type]->GetName())==0) return fHLe[type];
-      else delete fHLe[type];
-   }
-
-   fHLe[type] = new TH1D(name.Data(),
-         ";energy [MeV];luminosity [10^{50} erg/MeV]",
-         HL2(type)->GetNbinsY(),
-         HL2(type)->GetYaxis()->GetXbins()->GetArray());
-   fHLe[type]->SetStats(0);
-   fHLe[type]->SetLineColor(HL2(type)->GetLineColor());
-   fHLe[type]->SetTitle(GetTitle());
-
-   // calculate integral in [0, tmax]
-   for (UShort_t iy=1; iy<=HL2(type)->GetNbinsY(); iy++) {
-      Double_t content=0;
-      for (UShort_t ix=1; ix<=HL2(type)->GetNbinsX(); ix++) {
-         if (tmax<HL2(type)->GetXaxis()->GetBinCenter(ix)) break;
-         content += HL2(type)->GetBinContent(ix,iy) *
-            HL2(type)->GetXaxis()->GetBinWidth(ix);
-      }
-      fHLe[type]->SetBinContent(iy,content);
+   UShort_t flavor = SpectrumGrid::Flavor(type);
+   HistogramCache::Key key(HistogramCache::kLe, flavor, tmax);
+   if (TH1D *h = fCache.Find(key)) return h;
+
+   TString name = Form("hLe-%s-%d-%.4f", GetName(), flavor+1, tmax);
+   NEUS_PROFILE_COUNT(fProfiler.Rebuild(Profiler::kHLe));
+   const char *title = ";energy [MeV];luminosity [10^{50} erg/MeV]";
+   const SpectrumSummary *summary = Summary();
+   // full time range, also for models without N(t, E)
+   if (tmax>=fMaxT && summary->HasNe())
+      return FillHistogram(key, name, title, summary->NeAxis(),
+            summary->Integrated(SpectrumSummary::kLuminosity, flavor));
+   if (!summary->HasGrid()) {
+      Warning("HLe","Spectrum does not exist!");
+      Warning("HLe","NULL pointer is returned!");
+      return 0;
    }
-   return fHLe[type];
+
+   // integral in [TMin(), tmax]
+   vector<Double_t> content(summary->EnergyAxis().GetNbins());
+   summary->IntegrateT(SpectrumSummary::kLuminosity, flavor, tmax, &content[0]);
+   return FillHistogram(key, name, title, summary->EnergyAxis(), &content[0]);
 }
 
 //______________________________________________________________________________
@@ -271,32 +297,25 @@ TH1D* NEUS::SupernovaModel::HNt(UShort_t type, Double_t emax)
    }
    if (emax>fMaxE) emax=fMaxE;
 
-   TString name = Form("hNt-%s-%d-%.1f", GetName(), type, emax);
-   if (fHNt[type]) {
-      if (name.CompareTo(fHNt[type]->GetName())==0) return fHNt[type];
-      else delete fHNt[type];
+   UShort_t flavor = SpectrumGrid::Flavor(type);
+   HistogramCache::Key key(HistogramCache::kNt, flavor, emax);
+   if (TH1D *h = fCache.Find(key)) return h;
+
+   const SpectrumSummary *summary = Summary();
+   if (!summary->HasGrid()) {
+      Warning("HNt","Spectrum does not exist!");
+      Warning("HNt","NULL pointer is returned!");
+      return 0;
    }
 
-   Info("HNt", "Create %s",name.Data());
-   fHNt[type] = new TH1D(name.Data(),
+   TString name = Form("hNt-%s-%d-%.1f", GetName(), flavor+1, emax);
+   NEUS_PROFILE_COUNT(fProfiler.Rebuild(Profiler::kHNt));
+   // integral in [EMin(), emax]
+   vector<Double_t> content(summary->TimeAxis().GetNbins());
+   summary->IntegrateE(SpectrumSummary::kNumber, flavor, emax, &content[0]);
+   return FillHistogram(key, name,
          ";time [second];number of neutrinos [10^{50}/second]",
-         HN2(type)->GetNbinsX(),
-         HN2(type)->GetXaxis()->GetXbins()->GetArray());
-   fHNt[type]->SetStats(0);
-   fHNt[type]->SetLineColor(HN2(type)->GetLineColor());
-   fHNt[type]->SetTitle(GetTitle());
-
-   // calculate integral
-   for (UShort_t ix=1; ix<=HN2(type)->GetNbinsX(); ix++) {
-      Double_t content=0;
-      for (UShort_t iy=1; iy<=HN2(type)->GetNbinsY(); iy++) {
-         if (emax<HN2(type)->GetYaxis()->GetBinLowEdge(iy)) break;
-         content += HN2(type)->GetBinContent(ix,iy) *
-            HN2(type)->GetYaxis()->GetBinWidth(iy);
-      }
-      fHNt[type]->SetBinContent(ix,content);
-   }
-   return fHNt[type];
+         summary->TimeAxis(), &content[0]);
 }
 
 //______________________________________________________________________________
@@ -311,32 +330,26 @@ TH1D* NEUS::SupernovaModel::HLt(UShort_t type, Double_t emax)
    }
    if (emax>fMaxE) emax=fMaxE;
 
-   TString name = Form("hLt-%s-%d-%.1f", GetName(), type, emax);
-   if (fHLt[type]) {
-      if (name.CompareTo(fHLt[type]->GetName())==0) return fHLt[type];
-      else delete fHLt[type];
-   } 
+   UShort_t flavor = SpectrumGrid::Flavor(type);
+   HistogramCache::Key key(HistogramCache::kLt, flavor, emax);
+   if (TH1D *h = fCache.Find(key)) return h;
 
-   Info("HLt", "Create %s",name.Data());
-   fHLt[type] = new TH1D(name.Data(),
-         ";time [second];luminosity [10^{50} erg/second]",
-         HL2(type)->GetNbinsX(),
-         HL2(type)->GetXaxis()->GetXbins()->GetArray());
-   fHLt[type]->SetStats(0);
-   fHLt[type]->SetLineColor(HL2(type)->GetLineColor());
-   fHLt[type]->SetTitle(GetTitle());
-
-   // calculate integral
-   for (UShort_t ix=1; ix<=HL2(type)->GetNbinsX(); ix++) {
-      Double_t content=0;
-      for (UShort_t iy=1; iy<=HL2(type)->GetNbinsY(); iy++) {
-         if (emax<HL2(type)->GetYaxis()->GetBinLowEdge(iy)) break;
-         content += HL2(type)->GetBinContent(ix,iy) *
-            HL2(type)->GetYaxis()->GetBinWidth(iy);
-      }
-      fHLt[type]->SetBinContent(ix,content);
+   const SpectrumSummary *summary = Summary();
+   if (!summary->HasGrid()) {
+      Warning("HLt","Spectrum does not exist!");
+      Warning("HLt","NULL pointer is returned!");
+      return 0;
    }
-   return fHLt[type];
+
+   TString name = Form("hLt-%s-%d-%.1f", GetName(), flavor+1, emax);
+   NEUS_PROFILE_COUNT(fProfiler.Rebuild(Profiler::kHLt));
+   // integral in [EMin(), emax]
+   vector<Double_t> content(summary->TimeAxis().GetNbins());
+   summary->IntegrateE(SpectrumSummary::kLuminosity, flavor, emax,
+         &content[0]);
+   return FillHistogram(key, name,
+         ";time [second];luminosity [10^{50} erg/second]",
+         summary->TimeAxis(), &content[0]);
 }
 
 //______________________________________________________________________________
@@ -351,109 +364,384 @@ TH1D* NEUS::SupernovaModel::HEt(UShort_t type, Double_t emax)
    }
    if (emax>fMaxE) emax=fMaxE;
 
-   TString name = Form("hEt-%s-%d-%.1f", GetName(), type, emax);
-   if (fHEt[type]) {
-      if (name.CompareTo(fHEt[type]->GetName())==0) return fHEt[type];
-      else delete fHEt[type];
+   UShort_t flavor = SpectrumGrid::Flavor(type);
+   HistogramCache::Key key(HistogramCache::kEt, flavor, emax);
+   if (TH1D *h = fCache.Find(key)) return h;
+
+   const SpectrumSummary *summary = Summary();
+   if (!summary->HasGrid()) {
+      Warning("HEt","Spectrum does not exist!");
+      Warning("HEt","NULL pointer is returned!");
+      return 0;
    }
 
-   Info("HEt", "Create %s",name.Data());
-   fHEt[type] = new TH1D(name.Data(),
+   TString name = Form("hEt-%s-%d-%.1f", GetName(), flavor+1, emax);
+   NEUS_PROFILE_COUNT(fProfiler.Rebuild(Profiler::kHEt));
+   // average in [EMin(), emax]
+   vector<Double_t> content(summary->TimeAxis().GetNbins());
+   summary->AverageE(flavor, emax, &content[0]);
+   return FillHistogram(key, name,
          ";time [second];average energy [MeV/second]",
-         HN2(type)->GetNbinsX(),
-         HN2(type)->GetXaxis()->GetXbins()->GetArray());
-   fHEt[type]->SetStats(0);
-   fHEt[type]->SetLineColor(HN2(type)->GetLineColor());
-   fHEt[type]->SetTitle(GetTitle());
-
-   // calculate average
-   for (UShort_t ix=1; ix<=HN2(type)->GetNbinsX(); ix++) {
-      Double_t totalE=0, totalN=0;
-      for (UShort_t iy=1; iy<=HN2(type)->GetNbinsY(); iy++) {
-         if (emax<HN2(type)->GetYaxis()->GetBinLowEdge(iy)) break;
-         totalN += HN2(type)->GetBinContent(ix,iy) *
-            HN2(type)->GetYaxis()->GetBinWidth(iy);
-         totalE += HN2(type)->GetBinContent(ix,iy) * 
-            HN2(type)->GetYaxis()->GetBinWidth(iy) *
-            HN2(type)->GetYaxis()->GetBinCenter(iy);
+         summary->TimeAxis(), &content[0]);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::Eave(UShort_t type) const
+{
+   if (type<1 || type>6) {
+      Warning("Eave","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      Warning("Eave","Return 0!");
+      return 0;
+   }
+   Summary();
+   return fCore.Eave(type);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SupernovaModel::BuildGrid()
+{
+   fCore.SetGrid(0);
+
+   if (!fHN2[1] || !fHN2[2] || !fHN2[3]) {
+      Warning("BuildGrid","Spectrum does not exist!");
+      Warning("BuildGrid","Is the database correctly loaded?");
+      return;
+   }
+
+   const TAxis *xaxis = fHN2[1]->GetXaxis();
+   const TAxis *yaxis = fHN2[1]->GetYaxis();
+   UShort_t nbinsx = xaxis->GetNbins();
+   UShort_t nbinsy = yaxis->GetNbins();
+   vector<Double_t> binEdgesx(nbinsx+1), binEdgesy(nbinsy+1);
+   for (UShort_t ix=0; ix<=nbinsx; ix++)
+      binEdgesx[ix] = xaxis->GetBinLowEdge(ix+1);
+   for (UShort_t iy=0; iy<=nbinsy; iy++)
+      binEdgesy[iy] = yaxis->GetBinLowEdge(iy+1);
+
+   SpectrumGrid *grid = new SpectrumGrid;
+   grid->Create(nbinsx, &binEdgesx[0], nbinsy, &binEdgesy[0]);
+   fCore.SetGrid(grid);
+
+   for (UShort_t i=1; i<=3; i++) {
+      UShort_t flavor = SpectrumGrid::Flavor(i);
+      Double_t *n = grid->Content(SpectrumGrid::kNumber, flavor);
+      Double_t *l = grid->Content(SpectrumGrid::kLuminosity, flavor);
+      for (UShort_t ix=0; ix<nbinsx; ix++) {
+         for (UShort_t iy=0; iy<nbinsy; iy++) {
+            n[ix*nbinsy+iy] = fHN2[i]->GetBinContent(ix+1,iy+1);
+            if (fHL2[i]) l[ix*nbinsy+iy] = fHL2[i]->GetBinContent(ix+1,iy+1);
+         }
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SupernovaModel::CreateHistograms()
+{
+   const SpectrumGrid *grid = fCore.Grid();
+   if (!grid) return;
+
+   const GridAxis &xaxis = grid->TimeAxis();
+   const GridAxis &yaxis = grid->EnergyAxis();
+   UShort_t nbinsx = xaxis.GetNbins();
+   UShort_t nbinsy = yaxis.GetNbins();
+
+   vector<Double_t> bufferN, bufferL; // contents in compact storage
+   for (UShort_t i=1; i<=3; i++) {
+      if (fHN2[i]) delete fHN2[i];
+      if (fHL2[i]) delete fHL2[i];
+      fHN2[i] = new TH2D(Form("hN2%s%d", GetName(), i),
+            ";time [second];energy [MeV];",
+            nbinsx,xaxis.Edges(),nbinsy,yaxis.Edges());
+      fHL2[i] = new TH2D(Form("hL2%s%d", GetName(), i),
+            ";time [second];energy [MeV];",
+            nbinsx,xaxis.Edges(),nbinsy,yaxis.Edges());
+
+      UShort_t flavor = SpectrumGrid::Flavor(i);
+      const Double_t *n = grid->Content(SpectrumGrid::kNumber, flavor, bufferN);
+      const Double_t *l = grid->Content(SpectrumGrid::kLuminosity, flavor,
+            bufferL);
+      for (UShort_t ix=0; ix<nbinsx; ix++) {
+         for (UShort_t iy=0; iy<nbinsy; iy++) {
+            fHN2[i]->SetBinContent(ix+1,iy+1,n[ix*nbinsy+iy]);
+            fHL2[i]->SetBinContent(ix+1,iy+1,l[ix*nbinsy+iy]);
+         }
       }
-      fHEt[type]->SetBinContent(ix,totalE/totalN);
+
+      fHN2[i]->GetZaxis()->SetTitleOffset(-0.5);
+      fHL2[i]->GetZaxis()->SetTitleOffset(-0.5);
+      fHN2[i]->GetZaxis()->CenterTitle();
+      fHL2[i]->GetZaxis()->CenterTitle();
+      fHN2[i]->SetTitle(GetTitle());
+      fHL2[i]->SetTitle(GetTitle());
+      fHN2[i]->SetStats(0);
+      fHL2[i]->SetStats(0);
    }
-   return fHEt[type];
+   for (UShort_t i=4; i<=6; i++) {
+      fHN2[i]=fHN2[3];
+      fHL2[i]=fHL2[3];
+   }
+
+   fHN2[1]->GetZaxis()->SetTitle("number of #nu_{e} [10^{50}/s/MeV]");
+   fHN2[2]->GetZaxis()->SetTitle("number of #bar{#nu}_{e} [10^{50}/s/MeV]");
+   fHN2[3]->GetZaxis()->SetTitle("number of #nu_{x} [10^{50}/s/MeV]");
+
+   fHL2[1]->GetZaxis()->SetTitle("luminosity of #nu_{e} [10^{50} erg/s/MeV]");
+   fHL2[2]->GetZaxis()->SetTitle(
+         "luminosity of #bar{#nu}_{e} [10^{50} erg/s/MeV]");
+   fHL2[3]->GetZaxis()->SetTitle("luminosity of #nu_{x} [10^{50} erg/s/MeV]");
+
+   fHN2[1]->SetLineColor(kBlack);
+   fHN2[2]->SetLineColor(kRed);
+   fHN2[3]->SetLineColor(kBlue);
+
+   fHL2[1]->SetLineColor(kBlack);
+   fHL2[2]->SetLineColor(kRed);
+   fHL2[3]->SetLineColor(kBlue);
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::Eave(UShort_t type)
+const NEUS::SpectrumSummary* NEUS::SupernovaModel::Finalize()
 {
-   if (abs(fAverageE[type]-1.0)<0.01)
-      fAverageE[type] = Lall(type)/Nall(type)/1.60217646e-6;
-   return fAverageE[type];
+   if (!fCore.Grid() && fHN2[1]) BuildGrid();
+
+   SpectrumSummary *summary = new SpectrumSummary;
+   Summarize(*summary);
+   fCore.SetSummary(summary); // published after its tables are made
+   return summary;
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::N2(UShort_t type, Double_t time, Double_t energy)
+Int_t NEUS::SupernovaModel::Write(const char *name, Int_t option,
+      Int_t bufsize) const
 {
-   return HN2(type)->Interpolate(time, energy);
+   const SpectrumSummary *summary = Summary();
+   // copies of the summary, which is not saved
+   SupernovaModel *self = const_cast<SupernovaModel*>(this);
+   // histograms are saved rather than the grid, as in models.root
+   if (fCore.Grid() && !fHN2[1]) self->CreateHistograms();
+   for (UShort_t i=1; i<fgNtype; i++) {
+      UShort_t flavor = SpectrumGrid::Flavor(i);
+      self->fTotalN[i] = summary->TotalN(flavor);
+      self->fTotalL[i] = summary->TotalL(flavor);
+      self->fAverageE[i] = summary->AverageE(flavor);
+   }
+   return TNamed::Write(name, option, bufsize);
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::L2(UShort_t type, Double_t time, Double_t energy)
+void NEUS::SupernovaModel::SetInterpolation(Interpolator::EMode mode)
 {
-   return HL2(type)->Interpolate(time, energy);
+   fCore.SetInterpolation(mode);
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::Ne(UShort_t type, Double_t energy)
+void NEUS::SupernovaModel::SetStorage(SpectrumGrid::EStorage storage)
 {
-   if (GetName()[0]=='D')
-      return HNeFD(type)->Interpolate(energy);
-   return HNe(type)->Interpolate(energy);
+   if (storage!=fCore.Storage()) fCache.Clear(); // integrals are made again
+   fCore.SetStorage(storage);
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::Nt(UShort_t type, Double_t time)
+void NEUS::SupernovaModel::Summarize(SpectrumSummary &summary)
 {
-   return HNt(type)->Interpolate(time);
+   if (fCore.Grid()) summary.Fill(*fCore.Grid());
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::Nall(UShort_t type)
+const NEUS::SpectrumSummary* NEUS::SupernovaModel::Summary() const
+{
+   const SpectrumSummary *summary = fCore.Summary();
+   if (summary) return summary;
+
+   // a model read from a file has no summary yet
+   lock_guard<mutex> lock(gFinalizeMutex);
+   summary = fCore.Summary();
+   if (summary) return summary;
+   return const_cast<SupernovaModel*>(this)->Finalize();
+}
+
+//______________________________________________________________________________
+//
+
+const NEUS::SpectrumGrid* NEUS::SupernovaModel::Grid() const
+{
+   Summary(); // the grid is built by Finalize()
+   return fCore.Grid();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SupernovaModel::CountQuery(Profiler::EQuery query,
+      UShort_t flavor) const
+{
+   NEUS_PROFILE_COUNT(fProfiler.Query(query, flavor));
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::N2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   if (type<1 || type>6) {
+      Warning("N2","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   if (!Grid()) return 0;
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kN2,
+            SpectrumGrid::Flavor(type)));
+   return fCore.N2(type, time, energy);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::L2(UShort_t type, Double_t time,
+      Double_t energy) const
+{
+   if (type<1 || type>6) {
+      Warning("L2","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   if (!Grid()) return 0;
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kL2,
+            SpectrumGrid::Flavor(type)));
+   return fCore.L2(type, time, energy);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SupernovaModel::N2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   if (type<1 || type>6) {
+      Warning("N2","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      fill(result, result+n, 0.);
+      return;
+   }
+   if (!Grid()) { fill(result, result+n, 0.); return; }
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kN2,
+            SpectrumGrid::Flavor(type), n));
+   fCore.N2(type, time, energy, result, n);
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::SupernovaModel::L2(UShort_t type, const Double_t *time,
+      const Double_t *energy, Double_t *result, size_t n) const
+{
+   if (type<1 || type>6) {
+      Warning("L2","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      fill(result, result+n, 0.);
+      return;
+   }
+   if (!Grid()) { fill(result, result+n, 0.); return; }
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kL2,
+            SpectrumGrid::Flavor(type), n));
+   fCore.L2(type, time, energy, result, n);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::Ne(UShort_t type, Double_t energy,
+      Double_t tmax) const
+{
+   if (type<1 || type>6) {
+      Warning("Ne","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   if (GetName()[0]=='D') return NeFD(type, energy);
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kNe,
+            SpectrumGrid::Flavor(type)));
+   if (tmax>fMaxT) tmax=fMaxT;
+   Summary();
+   return fCore.Ne(type, energy, tmax);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::Nt(UShort_t type, Double_t time,
+      Double_t emax) const
+{
+   if (type<1 || type>6) {
+      Warning("Nt","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   if (emax>fMaxE) emax=fMaxE;
+   NEUS_PROFILE_COUNT(fProfiler.Query(Profiler::kNt,
+            SpectrumGrid::Flavor(type)));
+   Summary();
+   return fCore.Nt(type, time, emax);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t NEUS::SupernovaModel::Nall(UShort_t type) const
 {
    if (type<1 || type>6) {
       Warning("Nall","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
       Warning("Nall","Return 0!");
       return 0;
    }
-   if (fTotalN[type]==0) fTotalN[type] = HNe(type)->Integral("width");
-   return fTotalN[type];
+   Summary();
+   return fCore.Nall(type);
 }
 
 //______________________________________________________________________________
 //
 
-Double_t NEUS::SupernovaModel::Lall(UShort_t type)
+Double_t NEUS::SupernovaModel::Lall(UShort_t type) const
 {
    if (type<1 || type>6) {
       Warning("Lall","Type of neutrino must be one of 1, 2, 3, 4, 5, 6!");
       Warning("Lall","Return 0!");
       return 0;
    }
-   if (fTotalL[type]==0) fTotalL[type] = HLe(type)->Integral("width");
-   return fTotalL[type];
+   Summary();
+   return fCore.Lall(type);
 }
 
 //______________________________________________________________________________
 //
 
+NEUS::Profiler::Snapshot NEUS::SupernovaModel::GetProfile() const
+{
+   Profiler::Snapshot profile = fProfiler.GetSnapshot();
+   profile.histogramBytes = fCache.GetBytes();
+   // types 4, 5 and 6 share the histograms of type 3
+   for (UShort_t i=1; i<=3; i++) {
+      if (fHN2[i]) profile.histogramBytes +=
+         (fHN2[i]->GetNcells()+fHN2[i]->GetSumw2N())*sizeof(Double_t);
+      if (fHL2[i]) profile.histogramBytes +=
+         (fHL2[i]->GetNcells()+fHL2[i]->GetSumw2N())*sizeof(Double_t);
+   }
+   return profile;
+}
+
+//______________________________________________________________________________
+//
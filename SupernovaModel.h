@@ -1,17 +1,31 @@
 #ifndef SUPERNOVAMODEL_H
 #define SUPERNOVAMODEL_H
 
+#include "HistogramCache.h"
+#include "SpectrumModel.h"
+#include "Profiler.h"
+
 #include <TNamed.h>
 
 class TF1;
 class TH1D;
 class TH2D;
 
-namespace NEUS { class SupernovaModel; }
+namespace NEUS {
+   class SupernovaModel;
+   class GridAxis;
+   class SpectrumGrid;
+   class SpectrumSummary;
+}
 
 /**
  * Base class of all models.
  * The Fermi-Dirac approximation of energy spectra is implemenated here.
+ *
+ * Const member functions can be called from many threads at the same time
+ * on one loaded model. Functions returning histograms or TF1 create them on
+ * request and must not be used that way. Histograms of integrated spectra
+ * are kept in Cache() and stay valid until they are evicted from it.
  */
 class NEUS::SupernovaModel : public TNamed
 {
@@ -43,13 +57,71 @@ class NEUS::SupernovaModel : public TNamed
        * They are used for both visualization and fast interpolation.
        */
       TH2D *fHN2[fgNtype], *fHL2[fgNtype];
-      TH1D *fHNt[fgNtype], *fHNe[fgNtype];
-      TH1D *fHLt[fgNtype], *fHLe[fgNtype];
-      TH1D *fHEt[fgNtype];
+      /**
+       * N(E), L(E), N(t), L(t) and <E>(t) created by HNe(), HLe(), HNt(),
+       * HLt() and HEt() for the cutoffs requested recently.
+       */
+      HistogramCache fCache; //!
 
       TF1 *fNeFD[fgNtype];
 
+      /**
+       * Flat copy of fHN2 and fHL2 used by N2() and L2(), and spectra
+       * integrated over time or energy used by Ne(), Nt(), Nall(), Lall()
+       * and Eave(). It is not saved to ROOT files, but rebuilt from the
+       * histograms. Its summary is set by Finalize() and never changed
+       * afterwards.
+       */
+      SpectrumModel fCore; //!
+      /**
+       * Counters updated if the library is compiled with NEUS_PROFILE.
+       */
+      mutable Profiler fProfiler; //!
+      /**
+       * Count a query of the templated N2(), L2(), Nt() and Ne() in
+       * fProfiler. It is compiled in the library, so that those queries
+       * are counted or not as the library is, whatever their callers are.
+       */
+      void CountQuery(Profiler::EQuery query, UShort_t flavor) const;
+
       Double_t NeFermiDirac(Double_t *x, Double_t *parameter);
+      /**
+       * Copy contents of fHN2 and fHL2 to the grid of fCore.
+       * It has to be called whenever the histograms are (re)filled.
+       */
+      void BuildGrid();
+      /**
+       * Build the grid if needed and set the summary of fCore. It has to be
+       * called at the end of LoadData() and whenever data are changed
+       * afterwards. For a model read from a file, it is called by the first
+       * const query. Totals in the summary are copied to fTotalN, fTotalL
+       * and fAverageE by Write(), as they may need data not loaded yet.
+       */
+      const SpectrumSummary* Finalize();
+      /**
+       * Fill summary from loaded data, called by Finalize().
+       * Models override it to add time-integrated data or to adjust totals.
+       */
+      virtual void Summarize(SpectrumSummary &summary);
+      /**
+       * Summary of fCore, set by Finalize() if it does not exist yet.
+       */
+      const SpectrumSummary* Summary() const;
+      /**
+       * Create fHN2 and fHL2 from the grid of fCore.
+       * It is used when the grid is loaded without histograms, for example,
+       * from a binary file. Histograms are then created the first time they
+       * are requested.
+       */
+      void CreateHistograms();
+      /**
+       * Fill a histogram with content binned as axis and add it to fCache
+       * for key. The histogram evicted from a full cache is reused if it
+       * has the same binning, otherwise a new one is created.
+       * title gives titles of the axes, e.g. ";x;y".
+       */
+      TH1D* FillHistogram(const HistogramCache::Key &key, const char *name,
+            const char *title, const GridAxis &axis, const Double_t *content);
 
    public:
       SupernovaModel();
@@ -57,6 +129,14 @@ class NEUS::SupernovaModel : public TNamed
       virtual ~SupernovaModel() { Clear(); }
 
       virtual void Clear(Option_t *option="");
+      /**
+       * Write the model to the current directory with its totals and
+       * HN2() and HL2(), which are created from the grid if they are not
+       * yet, so that the model read back has its spectra.
+       */
+      using TNamed::Write;
+      virtual Int_t Write(const char *name=0, Int_t option=0,
+            Int_t bufsize=0) const;
 
       /**
        * Load data to histograms.
@@ -64,13 +144,73 @@ class NEUS::SupernovaModel : public TNamed
       virtual void LoadData(const char *dir) { fDataLocation=dir; }
       const char* DataLocation() { return fDataLocation; }
 
-      Double_t TMax() { return fMaxT; }
-      Double_t TMin() { return fMinT; }
-      Double_t EMax() { return fMaxE; }
-      Double_t EMin() { return fMinE; }
+      Double_t TMax() const { return fMaxT; }
+      Double_t TMin() const { return fMinT; }
+      Double_t EMax() const { return fMaxE; }
+      Double_t EMin() const { return fMinE; }
       void SetEMin(double E) { fMinE=E; }
       void SetEMax(double E) { fMaxE=E; }
 
+      /**
+       * Cache of histograms returned by HNe(), HLe(), HNt(), HLt() and
+       * HEt(), with counters of hits and misses.
+       */
+      const HistogramCache& Cache() const { return fCache; }
+      /**
+       * Maximal number of histograms kept in Cache(), 16 by default.
+       * Histograms beyond it are deleted, the least recently used first.
+       */
+      void SetCacheCapacity(UInt_t capacity) { fCache.SetCapacity(capacity); }
+
+      /**
+       * Calls and times of loading functions, numbers of histograms filled
+       * by HNe(), HLe(), HNt(), HLt() and HEt(), and numbers of points
+       * interpolated by N2(), L2(), Ne() and Nt() per flavor since the
+       * model was created or ResetProfile() was called, if the library is
+       * compiled with NEUS_PROFILE; and bytes held in histograms now.
+       * Use Text() or JSON() of the result for a report:
+       * printf("%s", model->GetProfile().Text(model->GetName()).c_str());
+       */
+      Profiler::Snapshot GetProfile() const;
+      void ResetProfile() { fProfiler.Reset(); }
+
+      /**
+       * Interpolation of N2(), L2(), and of Ne() and Nt() without cutoffs,
+       * Interpolator::kLinear by default. kLogLog, kMonotoneCubic or
+       * kBicubicLog keep accuracy on coarser grids. Tables of coefficients
+       * are made right away for a loaded model, so it must not be called
+       * while other threads use the model.
+       */
+      void SetInterpolation(Interpolator::EMode mode);
+      Interpolator::EMode Interpolation() const
+      { return fCore.Interpolation(); }
+      /**
+       * Keep N(t, E) and L(t, E) in float, or as 16-bit logarithms, to
+       * save memory in large sets of models, see SpectrumGrid::SetStorage()
+       * for the loss of accuracy. Integrals and totals are made from the
+       * stored contents, so that they agree with N2() and L2(), unless
+       * they are given by the database. It can be called before the model
+       * is loaded, and must not be called while other threads use it.
+       */
+      void SetStorage(SpectrumGrid::EStorage storage);
+      SpectrumGrid::EStorage Storage() const { return fCore.Storage(); }
+
+      /**
+       * Flat grid behind N2() and L2().
+       * NULL is returned if no spectrum is loaded.
+       */
+      const SpectrumGrid* Grid() const;
+      /**
+       * ROOT-free data and queries behind this model, see SpectrumModel.
+       */
+      const SpectrumModel& Core() const
+      { if (!fCore.Summary()) Summary(); return fCore; }
+      /**
+       * Whether N(t, E) and L(t, E) are loaded.
+       * Some models, such as the black hole one, only have N(E) and L(E).
+       */
+      Bool_t HasSpectrum() const { return fCore.Grid() || fHN2[1]; }
+
       /**
        * Number of neutrinos as a function of time and energy, N(t, E).
        * It is in unit of 1e50/MeV/second.
@@ -80,27 +220,90 @@ class NEUS::SupernovaModel : public TNamed
        * time: second after core collapse
        * energy: neutrino energy in unit of MeV/c2
        */
-      Double_t N2(UShort_t type, Double_t time, Double_t energy);
-      Double_t L2(UShort_t type, Double_t time, Double_t energy);
+      Double_t N2(UShort_t type, Double_t time, Double_t energy) const;
+      Double_t L2(UShort_t type, Double_t time, Double_t energy) const;
+      /**
+       * N(t, E) at n points (time[i], energy[i]), saved in result[i].
+       * It gives the same results as n calls of N2(type, time, energy) but
+       * runs vectorized over the points. result must hold n values.
+       */
+      void N2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, size_t n) const;
+      void L2(UShort_t type, const Double_t *time, const Double_t *energy,
+            Double_t *result, size_t n) const;
       /**
        * Number of neutrinos integrated over energy, N(t).
-       * It is in unit of 1e50/second.
+       * It is the integration of N(t, E) over [EMin(), emax], in unit of
+       * 1e50/second. Energy bins are cut exactly at emax.
        */
-      Double_t Nt(UShort_t type, Double_t time);
+      Double_t Nt(UShort_t type, Double_t time, Double_t emax=999.) const;
       /**
        * Number of neutrinos integrated over time, N(E).
-       * It is in unit of 1e50/MeV.
+       * It is the integration of N(t, E) over [TMin(), tmax], in unit of
+       * 1e50/MeV. Time bins are cut exactly at tmax.
        */
-      Double_t Ne(UShort_t type, Double_t energy);
+      Double_t Ne(UShort_t type, Double_t energy, Double_t tmax=999.) const;
       /**
        * Fermi-Dirac approximation of N(E)
        * It is in unit of 1e50/MeV/second.
        */
-      Double_t NeFD(UShort_t type, Double_t energy);
+      Double_t NeFD(UShort_t type, Double_t energy) const;
+
+      /**
+       * Total number of neutrinos, in unit of 1e50.
+       */
+      virtual Double_t Nall(UShort_t type) const;
+      /**
+       * Total luminosity of neutrinos, in unit of 1e50 erg.
+       */
+      virtual Double_t Lall(UShort_t type) const;
+      /**
+       * Average energy of neutrinos, in unit of MeV.
+       */
+      Double_t Eave(UShort_t type) const;
 
-      virtual Double_t Nall(UShort_t type);
-      virtual Double_t Lall(UShort_t type);
-      Double_t Eave(UShort_t type);
+      /**
+       * Same as the queries above for a type known at compile time, e.g.
+       * model->N2<2>(time, energy) in a loop over anti-v_e: the type is
+       * checked and mapped to its flavor by the compiler, see SpectrumModel,
+       * so nothing is tested per call but whether data are loaded. The
+       * source of N(E) is chosen at compile time as well: Ne<type,
+       * SpectrumModel::kFermiDirac>() gives NeFD(), as Ne() does for the
+       * Divari approximation of LivermoreModel.
+       */
+      template<UShort_t type>
+      Double_t N2(Double_t time, Double_t energy) const
+      {
+         CountQuery(Profiler::kN2, SpectrumModel::Flavor<type>::value);
+         return Core().N2<type>(time, energy);
+      }
+      template<UShort_t type>
+      Double_t L2(Double_t time, Double_t energy) const
+      {
+         CountQuery(Profiler::kL2, SpectrumModel::Flavor<type>::value);
+         return Core().L2<type>(time, energy);
+      }
+      template<UShort_t type>
+      Double_t Nt(Double_t time, Double_t emax=999.) const
+      {
+         if (emax>fMaxE) emax=fMaxE;
+         CountQuery(Profiler::kNt, SpectrumModel::Flavor<type>::value);
+         return Core().Nt<type>(time, emax);
+      }
+      template<UShort_t type,
+         SpectrumModel::ESource source=SpectrumModel::kTabulated>
+      Double_t Ne(Double_t energy, Double_t tmax=999.) const
+      {
+         if (tmax>fMaxT) tmax=fMaxT;
+         CountQuery(Profiler::kNe, SpectrumModel::Flavor<type>::value);
+         return Core().Ne<type, source>(energy, tmax);
+      }
+      template<UShort_t type> Double_t Nall() const
+      { return Core().Nall<type>(); }
+      template<UShort_t type> Double_t Lall() const
+      { return Core().Lall<type>(); }
+      template<UShort_t type> Double_t Eave() const
+      { return Core().Eave<type>(); }
 
       /**
        * N(t, E) in TH2D format.
@@ -112,7 +315,9 @@ class NEUS::SupernovaModel : public TNamed
       /**
        * N(t) in TH1D format.
        * It is the integration of N(t, E) over [EMin(), emax].
-       * If emax>EMax(), emax is set to be EMax().
+       * If emax>EMax(), emax is set to be EMax(). The energy bin containing
+       * emax is included up to emax. Histograms for a new emax are filled
+       * from cumulative sums made at load time in O(1) per bin.
        * x axis: second after the core collapse, in [TMin(), TMax()].
        * y axis: number of neutrinos in unit of 1e50/second.
        */
@@ -120,7 +325,9 @@ class NEUS::SupernovaModel : public TNamed
       /**
        * N(E) in TH1D format.
        * It is the integration of N(t, E) over [TMin(), tmax].
-       * If tmax>TMax(), tmax is set to be TMax().
+       * If tmax>TMax(), tmax is set to be TMax(). The time bin containing
+       * tmax is included up to tmax. Histograms for a new tmax are filled
+       * from cumulative sums made at load time in O(1) per bin.
        * x axis: neutrino energy, in [EMin(), EMax()].
        * y axis: number of neutrinos in unit of 1e50/MeV.
        */
@@ -148,7 +355,7 @@ class NEUS::SupernovaModel : public TNamed
        */
       TH1D* HEt(UShort_t type=1, Double_t emax=999.);
 
-      ClassDef(SupernovaModel,1);
+      ClassDef(SupernovaModel,2);
 };
 
 #endif
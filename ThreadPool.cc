@@ -0,0 +1,139 @@
+#include "ThreadPool.h"
+using namespace std;
+
+namespace {
+   // pool and queue of the worker running in the current thread
+   thread_local NEUS::ThreadPool *gPool = 0;
+   thread_local unsigned int gIndex = 0;
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::ThreadPool::ThreadPool(unsigned int nthreads) : fQueues(), fThreads(),
+   fMutex(), fWake(), fStop(false), fQueued(0), fPending(0), fNext(0),
+   fError()
+{
+   if (nthreads==0) nthreads = thread::hardware_concurrency();
+   if (nthreads==0) nthreads = 1;
+   for (unsigned int i=0; i<nthreads; i++)
+      fQueues.push_back(unique_ptr<Queue>(new Queue));
+   for (unsigned int i=0; i<nthreads; i++)
+      fThreads.push_back(thread(&ThreadPool::Work, this, i));
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::ThreadPool::~ThreadPool()
+{
+   try { Wait(); } catch (...) {}
+   {
+      lock_guard<mutex> lock(fMutex);
+      fStop = true;
+   }
+   fWake.notify_all();
+   for (unsigned int i=0; i<fThreads.size(); i++) fThreads[i].join();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ThreadPool::Submit(const Task &task)
+{
+   unsigned int index = gPool==this ? gIndex : fNext++ % fQueues.size();
+   fPending++;
+   {
+      // counted under fMutex so that no worker misses the wake-up, and
+      // before the task is queued so that Take() never counts below 0
+      lock_guard<mutex> lock(fMutex);
+      fQueued++;
+   }
+   {
+      lock_guard<mutex> lock(fQueues[index]->fMutex);
+      fQueues[index]->fTasks.push_back(task);
+   }
+   fWake.notify_one();
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::ThreadPool::Take(unsigned int index, Task &task)
+{
+   const unsigned int n = fQueues.size();
+   for (unsigned int i=0; i<n; i++) {
+      Queue &queue = *fQueues[(index+i)%n];
+      lock_guard<mutex> lock(queue.fMutex);
+      if (queue.fTasks.empty()) continue;
+      if (i==0) { // newest task of the own queue
+         task = queue.fTasks.back();
+         queue.fTasks.pop_back();
+      } else { // oldest task of another queue
+         task = queue.fTasks.front();
+         queue.fTasks.pop_front();
+      }
+      fQueued--;
+      return true;
+   }
+   return false;
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ThreadPool::Run(Task &task)
+{
+   try {
+      task();
+   } catch (...) {
+      lock_guard<mutex> lock(fMutex);
+      if (!fError) fError = current_exception();
+   }
+   task = Task();
+   if (--fPending==0) {
+      lock_guard<mutex> lock(fMutex);
+      fWake.notify_all();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ThreadPool::Work(unsigned int index)
+{
+   gPool = this;
+   gIndex = index;
+   Task task;
+   for (;;) {
+      if (Take(index, task)) { Run(task); continue; }
+      unique_lock<mutex> lock(fMutex);
+      fWake.wait(lock, [this] { return fStop || fQueued>0; });
+      if (fStop && fQueued==0) return;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::ThreadPool::Wait()
+{
+   Task task;
+   unsigned int index = fNext % fQueues.size();
+   for (;;) {
+      if (Take(index, task)) { Run(task); continue; }
+      unique_lock<mutex> lock(fMutex);
+      fWake.wait(lock, [this] { return fPending==0 || fQueued>0; });
+      if (fPending==0) break;
+   }
+
+   lock_guard<mutex> lock(fMutex);
+   if (fError) {
+      exception_ptr error = fError;
+      fError = exception_ptr();
+      rethrow_exception(error);
+   }
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,80 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+namespace NEUS { class ThreadPool; }
+
+/**
+ * Work-stealing thread pool.
+ * Each worker has its own queue of tasks. A task submitted from a worker is
+ * put into the queue of that worker, others are distributed round-robin.
+ * A worker runs the newest task in its own queue first and steals the
+ * oldest task from other queues when its own queue is empty, so that tasks
+ * spawning sub-tasks keep their data in cache while idle workers take over
+ * whole branches of work.
+ */
+class NEUS::ThreadPool
+{
+   public:
+      typedef std::function<void()> Task;
+
+   private:
+      struct Queue {
+         std::mutex fMutex;
+         std::deque<Task> fTasks;
+      };
+      std::vector<std::unique_ptr<Queue> > fQueues; // one per worker
+      std::vector<std::thread> fThreads;
+
+      std::mutex fMutex; // protects fStop and the wake-up condition
+      std::condition_variable fWake;
+      bool fStop;
+      std::atomic<unsigned int> fQueued; // tasks in or entering queues
+      std::atomic<unsigned int> fPending; // tasks not yet finished
+      std::atomic<unsigned int> fNext; // queue for the next external task
+      std::exception_ptr fError; // first exception thrown by a task
+
+      void Work(unsigned int index);
+      /**
+       * Take a task from queue index, or steal one from the others.
+       */
+      bool Take(unsigned int index, Task &task);
+      void Run(Task &task);
+
+      ThreadPool(const ThreadPool&);
+      ThreadPool& operator=(const ThreadPool&);
+
+   public:
+      /**
+       * Start nthreads workers; 0 means one per hardware thread.
+       */
+      explicit ThreadPool(unsigned int nthreads=0);
+      /**
+       * Wait() and stop workers.
+       */
+      ~ThreadPool();
+
+      unsigned int GetNthreads() const { return fThreads.size(); }
+
+      /**
+       * Queue a task. It can be called from inside a task.
+       */
+      void Submit(const Task &task);
+      /**
+       * Run tasks in the calling thread until all submitted tasks, including
+       * those submitted by tasks, are done. The first exception thrown by a
+       * task is rethrown. It must not be called from inside a task.
+       */
+      void Wait();
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "TimeSlicer.h"
+
+#include <algorithm>
+using namespace std;
+
+//______________________________________________________________________________
+//
+
+NEUS::TimeSlicer::TimeSlicer(const SpectrumSummary &summary, double width)
+   : fSummary(&summary), fOwned(), fLow(), fHigh(), fSlice(), fWidth(width),
+   fStart(0), fStop(0)
+{
+   Init();
+}
+
+//______________________________________________________________________________
+//
+
+NEUS::TimeSlicer::TimeSlicer(const SpectrumGrid &grid, double width)
+   : fSummary(0), fOwned(new SpectrumSummary), fLow(), fHigh(), fSlice(),
+   fWidth(width), fStart(0), fStop(0)
+{
+   fOwned->Fill(grid);
+   fSummary = fOwned.get();
+   Init();
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::TimeSlicer::Init()
+{
+   for (unsigned short f=0; f<fgNflavor; f++) fN[f] = fL[f] = 0;
+   if (!fSummary->HasGrid()) return;
+   const unsigned short ne = EnergyAxis().GetNbins();
+   fLow.assign(2*fgNflavor*ne, 0.);
+   fHigh.assign(2*fgNflavor*ne, 0.);
+   fSlice.assign(2*fgNflavor*ne, 0.);
+   Reset(TimeAxis().Min());
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::TimeSlicer::Cut(double t, double *rows) const
+{
+   const unsigned short ne = EnergyAxis().GetNbins();
+   unsigned short k;
+   double frac;
+   TimeAxis().Cut(t, k, frac);
+
+   for (unsigned short i=0; i<2*fgNflavor; i++, rows+=ne) {
+      // N of each flavor, then L of each flavor
+      const double *row = fSummary->CumulativeT(
+            SpectrumSummary::EQuantity(i/fgNflavor), i%fgNflavor) + k*ne;
+      if (frac>0)
+         for (unsigned short ie=0; ie<ne; ie++)
+            rows[ie] = row[ie] + (row[ne+ie]-row[ie])*frac;
+      else
+         for (unsigned short ie=0; ie<ne; ie++) rows[ie] = row[ie];
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void NEUS::TimeSlicer::Reset(double start)
+{
+   fStart = fStop = start;
+   for (unsigned short f=0; f<fgNflavor; f++) fN[f] = fL[f] = 0;
+   if (!fSummary->HasGrid()) return;
+   fill(fSlice.begin(), fSlice.end(), 0.);
+   Cut(start, &fLow[0]);
+}
+
+//______________________________________________________________________________
+//
+
+bool NEUS::TimeSlicer::Next(double stop)
+{
+   if (!fSummary->HasGrid() || !(stop>fStop) || fStop>=TimeAxis().Max())
+      return false;
+   const GridAxis &eaxis = EnergyAxis();
+   const unsigned short ne = eaxis.GetNbins();
+   Cut(stop, &fHigh[0]);
+   for (unsigned short i=0; i<2*fgNflavor; i++) {
+      const double *low = &fLow[i*ne], *high = &fHigh[i*ne];
+      double *slice = &fSlice[i*ne];
+      double sum = 0;
+      for (unsigned short ie=0; ie<ne; ie++) {
+         slice[ie] = high[ie]-low[ie];
+         sum += slice[ie] * eaxis.BinWidth(ie);
+      }
+      if (i<fgNflavor) fN[i] = sum;
+      else fL[i-fgNflavor] = sum;
+   }
+   // the stop of this window is the start of the next one
+   fLow.swap(fHigh);
+   fStart = fStop;
+   fStop = stop;
+   return true;
+}
+
+//______________________________________________________________________________
+//
@@ -0,0 +1,123 @@
+#ifndef TIMESLICER_H
+#define TIMESLICER_H
+
+#include "SpectrumSummary.h"
+
+#include <memory>
+#include <vector>
+
+namespace NEUS { class TimeSlicer; }
+
+/**
+ * Walk through N(t, E) and L(t, E) of a grid in consecutive windows of time.
+ * Each step gives N(E) and L(E) integrated over the next window, and the
+ * number, luminosity and average energy in it, for all flavors at once. N
+ * and L integrated over time are those that SpectrumSummary keeps, e.g. the
+ * summary of a model, so a step takes two cuts of cumulative rows,
+ * O(EBins()) work, whatever the width of the window, and allocates nothing.
+ * Bins on the borders of a window are cut exactly, as in
+ * SpectrumSummary::IntegrateT(), so that consecutive windows add up to the
+ * full integrals.
+ *
+ * Windows have a fixed width with Next(), or end at any time with
+ * Next(stop), e.g. the clock of a detector read out live. Reset() moves the
+ * start of the next window anywhere, forward or backward.
+ *
+ * A slicer is a cursor: it must not be shared by threads, but any number of
+ * slicers can walk through one grid. This class does not depend on ROOT.
+ */
+class NEUS::TimeSlicer
+{
+   private:
+      static const unsigned short fgNflavor = SpectrumGrid::fgNflavor;
+
+      const SpectrumSummary *fSummary; // of the cumulative rows
+      std::unique_ptr<SpectrumSummary> fOwned; // made from a grid, if any
+      /**
+       * Cumulative rows cut at the start and the stop of the window, and
+       * their difference, 2*fgNflavor rows of nE values each: N of each
+       * flavor, then L of each flavor.
+       */
+      std::vector<double> fLow, fHigh, fSlice;
+
+      double fWidth, fStart, fStop;
+      double fN[fgNflavor], fL[fgNflavor];
+
+      /**
+       * Allocate rows and start at the beginning of the summary.
+       */
+      void Init();
+      /**
+       * Integrals of N and L over [TimeAxis().Min(), t], saved in rows.
+       */
+      void Cut(double t, double *rows) const;
+
+      TimeSlicer(const TimeSlicer&);
+      TimeSlicer& operator=(const TimeSlicer&);
+
+   public:
+      /**
+       * Walk through the grid of summary, which must outlive the slicer
+       * and must not be refilled while it is used. Windows are width
+       * seconds wide and the first one starts at the beginning of the grid.
+       */
+      TimeSlicer(const SpectrumSummary &summary, double width);
+      /**
+       * Walk through grid with a summary of its own, for a grid without a
+       * model. grid must outlive the slicer.
+       */
+      TimeSlicer(const SpectrumGrid &grid, double width);
+
+      /**
+       * Start the next window at start, in second after core collapse.
+       * The current window becomes empty.
+       */
+      void Reset(double start);
+      void SetWidth(double width) { fWidth = width; }
+      double Width() const { return fWidth; }
+
+      /**
+       * Move to [Stop(), Stop()+Width()].
+       * False is returned once Stop() reaches the end of the grid.
+       */
+      bool Next() { return Next(fStop+fWidth); }
+      /**
+       * Move to [Stop(), stop]. False is returned, and nothing is done, if
+       * stop is not after Stop() or if the window starts at or after the end
+       * of the grid.
+       */
+      bool Next(double stop);
+
+      /**
+       * The current window. Parts of it outside of the grid contain no
+       * neutrinos.
+       */
+      double Start() const { return fStart; }
+      double Stop() const { return fStop; }
+
+      const GridAxis& TimeAxis() const { return fSummary->TimeAxis(); }
+      const GridAxis& EnergyAxis() const { return fSummary->EnergyAxis(); }
+
+      /**
+       * N(E) in unit of 1e50/MeV and L(E) in unit of 1e50 erg/MeV
+       * integrated over the window, in each bin of EnergyAxis().
+       * See SpectrumGrid::Flavor() for flavor indices.
+       */
+      const double* Ne(unsigned short flavor) const
+      { return &fSlice[flavor*EnergyAxis().GetNbins()]; }
+      const double* Le(unsigned short flavor) const
+      { return &fSlice[(fgNflavor+flavor)*EnergyAxis().GetNbins()]; }
+      /**
+       * Number of neutrinos in unit of 1e50 and their energy in unit of
+       * 1e50 erg in the window.
+       */
+      double N(unsigned short flavor) const { return fN[flavor]; }
+      double L(unsigned short flavor) const { return fL[flavor]; }
+      /**
+       * Average energy in MeV in the window, 0 if it is empty.
+       */
+      double Eave(unsigned short flavor) const
+      { return fN[flavor]>0 ? fL[flavor]/fN[flavor]/1.60217646e-6 : 0; }
+};
+
+#endif